@@ -18,7 +18,12 @@
 #include <assert.h>
 #include <memory.h>
 #include <immintrin.h>
+#include <thread>
+#include <atomic>
+#include <vector>
 
+#include "SuperSort.h"
+#include "SuperSortVector.h"
 #include "SuperQuickSort.h"
 
 #ifdef SUPERQUICKSORT_UNSIGNED
@@ -32,9 +37,16 @@ typedef int T;
 const T PADDING_MAX = 0x7FFFFFFF;
 #endif
 
+#include "SuperSortNetwork.h"
+
+// p[eBVŉubN(32vf)ǂ݂邩B̃CeVubN1̏ԂŊxɂ
+#ifndef SUPERQUICKSORT_PREFETCH_BLOCKS
+#define SUPERQUICKSORT_PREFETCH_BLOCKS 8
+#endif
+
 namespace {
-	int SuperQuickSortRec(T* array, size_t num);
-	void SuperQuickSortRecAligned(T* array, size_t num);
+	int SuperQuickSortRec(T* array, size_t num, size_t lo, size_t hi);
+	void SuperQuickSortRecAligned(T* array, size_t num, size_t lo, size_t hi);
 	//void SuperQuickSortEnd(T* array, size_t num);
 	void SuperSort64(T* array);
 
@@ -56,6 +68,23 @@ namespace {
 		_mm256_store_si256((__m256i*)(p + 24), m3);
 	}
 
+	// 32[h(LbVC2{)ǂ݂
+	void Prefetch32(const T* p)
+	{
+		_mm_prefetch((const char*)(p + 0), _MM_HINT_T0);
+		_mm_prefetch((const char*)(p + 16), _MM_HINT_T0);
+	}
+
+	// s{bgIŎɃMU[64̃Tvʒuǂ݂
+	void PrefetchSamples(const int* ofsArray)
+	{
+		int j;
+		for (j = 0; j < 64; j++)
+		{
+			_mm_prefetch((const char*)(ofsArray + j * 32), _MM_HINT_T0);
+		}
+	}
+
 	// r
 	void Comparator(__m256i& lo, __m256i& hi)
 	{
@@ -67,18 +96,7 @@ namespace {
 
 	// WX^8̃oCgjbN\[gs
 #define LineBitonicSort() \
-		Comparator(m0, m4);\
-		Comparator(m1, m5);\
-		Comparator(m2, m6);\
-		Comparator(m3, m7);\
-		Comparator(m0, m2);\
-		Comparator(m1, m3);\
-		Comparator(m4, m6);\
-		Comparator(m5, m7);\
-		Comparator(m0, m1);\
-		Comparator(m2, m3);\
-		Comparator(m4, m5);\
-		Comparator(m6, m7);
+		ApplyNetwork<HalfCleanerNetwork<8>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);
 
 	// xmmWX^0Ԗڂ2ԖځA1Ԗڂ3Ԗڂ̗vfꂼ\[g
 	void ComparatorLR2(__m256i& m0, __m256i& m1)
@@ -123,21 +141,11 @@ namespace {
 #if 0
 #define Merge3232() {\
 		m0 = _mm256_permutevar8x32_epi32(m0, maskflip8);\
-		Comparator(m0, m7);\
 		m1 = _mm256_permutevar8x32_epi32(m1, maskflip8);\
-		Comparator(m1, m6);\
 		m2 = _mm256_permutevar8x32_epi32(m2, maskflip8);\
-		Comparator(m2, m5);\
 		m3 = _mm256_permutevar8x32_epi32(m3, maskflip8);\
-		Comparator(m3, m4);\
-		Comparator(m0, m2);\
-		Comparator(m1, m3);\
-		Comparator(m4, m6);\
-		Comparator(m5, m7);\
-		Comparator(m0, m1);\
-		Comparator(m2, m3);\
-		Comparator(m4, m5);\
-		Comparator(m6, m7);\
+		ApplyNetwork<FlipNetwork<8>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);\
+		ApplyNetwork<HalfCleanerNetwork<8, 2>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);\
 		Swapupdn4(m0, m4);\
 		Swapupdn4(m1, m5);\
 		Swapupdn4(m2, m6);\
@@ -172,21 +180,11 @@ namespace {
 	{
 		__m256i maskflip8 = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
 		m0 = _mm256_permutevar8x32_epi32(m0, maskflip8);\
-		Comparator(m0, m7);\
 		m1 = _mm256_permutevar8x32_epi32(m1, maskflip8);\
-		Comparator(m1, m6);\
 		m2 = _mm256_permutevar8x32_epi32(m2, maskflip8);\
-		Comparator(m2, m5);\
 		m3 = _mm256_permutevar8x32_epi32(m3, maskflip8);\
-		Comparator(m3, m4);\
-		Comparator(m0, m2);\
-		Comparator(m1, m3);\
-		Comparator(m4, m6);\
-		Comparator(m5, m7);\
-		Comparator(m0, m1);\
-		Comparator(m2, m3);\
-		Comparator(m4, m5);\
-		Comparator(m6, m7);\
+		ApplyNetwork<FlipNetwork<8>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);\
+		ApplyNetwork<HalfCleanerNetwork<8, 2>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);\
 		Swapupdn4(m0, m4);\
 		Swapupdn4(m1, m5);\
 		Swapupdn4(m2, m6);\
@@ -216,18 +214,7 @@ namespace {
 #endif
 	/*
 #define BitonicMerge64() {\
-		Comparator(m0, m4);\
-		Comparator(m1, m5);\
-		Comparator(m2, m6);\
-		Comparator(m3, m7);\
-		Comparator(m0, m2);\
-		Comparator(m1, m3);\
-		Comparator(m4, m6);\
-		Comparator(m5, m7);\
-		Comparator(m0, m1);\
-		Comparator(m2, m3);\
-		Comparator(m4, m5);\
-		Comparator(m6, m7);\
+		ApplyNetwork<HalfCleanerNetwork<8>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);\
 		Swapupdn4(m0, m4);\
 		Swapupdn4(m1, m5);\
 		Swapupdn4(m2, m6);\
@@ -264,25 +251,7 @@ namespace {
 		Load32(array, m0, m1, m2, m3);
 		Load32(array + 32, m4, m5, m6, m7);
 		// 8Ńob`[}[W\[gs
-		Comparator(m0, m1);
-		Comparator(m2, m3);
-		Comparator(m4, m5);
-		Comparator(m6, m7);
-		Comparator(m0, m2);
-		Comparator(m1, m3);
-		Comparator(m4, m6);
-		Comparator(m5, m7);
-		Comparator(m1, m2);
-		Comparator(m5, m6);
-		Comparator(m0, m4);
-		Comparator(m1, m5);
-		Comparator(m2, m6);
-		Comparator(m3, m7);
-		Comparator(m2, m4);
-		Comparator(m3, m5);
-		Comparator(m1, m2);
-		Comparator(m3, m4);
-		Comparator(m5, m6);
+		ApplyNetwork<OddEvenMergeSortNetwork<8>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);
 
 		// 4ŃoCgjbN\[g1is
 		//	DebugPrT();
@@ -367,25 +336,7 @@ namespace {
 		Load32(array, m0, m1, m2, m3);
 		Load32(array + 32, m4, m5, m6, m7);
 		// 8Ńob`[}[W\[gs
-		Comparator(m0, m1);
-		Comparator(m2, m3);
-		Comparator(m4, m5);
-		Comparator(m6, m7);
-		Comparator(m0, m2);
-		Comparator(m1, m3);
-		Comparator(m4, m6);
-		Comparator(m5, m7);
-		Comparator(m1, m2);
-		Comparator(m5, m6);
-		Comparator(m0, m4);
-		Comparator(m1, m5);
-		Comparator(m2, m6);
-		Comparator(m3, m7);
-		Comparator(m2, m4);
-		Comparator(m3, m5);
-		Comparator(m1, m2);
-		Comparator(m3, m4);
-		Comparator(m5, m6);
+		ApplyNetwork<OddEvenMergeSortNetwork<8>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);
 
 		// 4ŃoCgjbN\[g1is
 		//	DebugPrT();
@@ -449,13 +400,10 @@ namespace {
 		// 32vf̃oCgjbN}[Ws
 		__m256i maskflip8 = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
 		m0 = _mm256_permutevar8x32_epi32(m0, maskflip8);
-		Comparator(m0, m7);
 		m1 = _mm256_permutevar8x32_epi32(m1, maskflip8);
-		Comparator(m1, m6);
 		m2 = _mm256_permutevar8x32_epi32(m2, maskflip8);
-		Comparator(m2, m5);
 		m3 = _mm256_permutevar8x32_epi32(m3, maskflip8);
-		Comparator(m3, m4);
+		ApplyNetwork<FlipNetwork<8>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);
 
 		ComparatorLR(m0);
 		ComparatorLR(m1);
@@ -547,25 +495,7 @@ namespace {
 	{\
 		__m256i ms, mt;\
 		/* 8Ńob`[}[W\[gs */\
-		Comparator(m0, m1);\
-		Comparator(m2, m3);\
-		Comparator(m4, m5);\
-		Comparator(m6, m7);\
-		Comparator(m0, m2);\
-		Comparator(m1, m3);\
-		Comparator(m4, m6);\
-		Comparator(m5, m7);\
-		Comparator(m1, m2);\
-		Comparator(m5, m6);\
-		Comparator(m0, m4);\
-		Comparator(m1, m5);\
-		Comparator(m2, m6);\
-		Comparator(m3, m7);\
-		Comparator(m2, m4);\
-		Comparator(m3, m5);\
-		Comparator(m1, m2);\
-		Comparator(m3, m4);\
-		Comparator(m5, m6);\
+		ApplyNetwork<OddEvenMergeSortNetwork<8>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);\
 \
 		/* 4ŃoCgjbN\[g1is */\
 		mt = _mm256_alignr_epi8(m0, m0, 8);\
@@ -627,13 +557,10 @@ namespace {
 \
 		__m256i maskflip8 = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);\
 		m0 = _mm256_permutevar8x32_epi32(m0, maskflip8);\
-		Comparator(m0, m7);\
 		m1 = _mm256_permutevar8x32_epi32(m1, maskflip8);\
-		Comparator(m1, m6);\
 		m2 = _mm256_permutevar8x32_epi32(m2, maskflip8);\
-		Comparator(m2, m5);\
 		m3 = _mm256_permutevar8x32_epi32(m3, maskflip8);\
-		Comparator(m3, m4);\
+		ApplyNetwork<FlipNetwork<8>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);\
 \
 		ComparatorLR(m0);\
 		ComparatorLR(m1);\
@@ -679,7 +606,8 @@ namespace {
 	}\
 
 	// 32vfɃ\[gꂽ32vfŃACgꂽf[^󂯎ANCbN\[gs
-	void SuperQuickSortRecAligned(T* array, size_t num)
+	// [lo, hi)͈̔͂Ɋ|ȂԂ̍ċA͍sȂ
+	void SuperQuickSortRecAligned(T* array, size_t num, size_t lo, size_t hi)
 	{
 		T* alignedArray = array;
 		size_t alignedSize = num;
@@ -868,6 +796,10 @@ namespace {
 				for (i = 0; i + 2048 <= alignedSize; i += 2048)
 				{
 					int* ofsArray = (int*)alignedArray + i + 15;
+					if (i + 2048 * 2 <= alignedSize)
+					{
+						PrefetchSamples(ofsArray + 2048);
+					}
 					m0 = _mm256_i32gather_epi32(ofsArray + 256 * 0, index, 4);
 					m1 = _mm256_i32gather_epi32(ofsArray + 256 * 1, index, 4);
 					m2 = _mm256_i32gather_epi32(ofsArray + 256 * 2, index, 4);
@@ -884,9 +816,11 @@ namespace {
 						{
 							ofsArray[j * 32] = alignedArray[idx];
 							alignedArray[idx] = center;
-							if ((T*)ofsArray - 15 + j * 32 != alignedArray)
+							T* block = (T*)ofsArray - 15 + j * 32;
+							if (block != alignedArray)
 							{
-								SuperSort64((T*)ofsArray - 15 + j * 32);
+								// ̃ubN͔͈͊O󂳂Ȃ悤ÕubNƍ킹ă\[g
+								SuperSort64(block + 64 > alignedArray + alignedSize ? block - 32 : block);
 							}
 							idx++;
 							break;
@@ -922,6 +856,10 @@ namespace {
 						break;
 					}
 					Load32(l, m0, m1, m2, m3);
+					if (r - l > SUPERQUICKSORT_PREFETCH_BLOCKS * 32)
+					{
+						Prefetch32(l + SUPERQUICKSORT_PREFETCH_BLOCKS * 32);
+					}
 				}
 				if (m4.m256i_i32[0] >= pivot)
 				{
@@ -933,21 +871,27 @@ namespace {
 						break;
 					}
 					Load32(r, m4, m5, m6, m7);
+					if (r - l > SUPERQUICKSORT_PREFETCH_BLOCKS * 32)
+					{
+						Prefetch32(r - SUPERQUICKSORT_PREFETCH_BLOCKS * 32);
+					}
 				}
 			}
-			if (r != array)
+			size_t ofs = l - array;
+			if (r != array && lo < ofs + 32)
 			{
-				SuperQuickSortRecAligned(array, (r + 32) - array);
+				SuperQuickSortRecAligned(array, (r + 32) - array, lo, hi);
 			}
-			if (l != array + num - 32)
+			if (l != array + num - 32 && ofs < hi)
 			{
-				SuperQuickSortRecAligned(l, array - l + num);
+				SuperQuickSortRecAligned(l, array - l + num, lo > ofs ? lo - ofs : 0, hi - ofs);
 			}
 		}
 	}
 
 	// 32vfɃ\[gꂽf[^󂯎ANCbN\[gs
-	int SuperQuickSortRec(T* array, size_t num)
+	// [lo, hi)͈̔͂Ɋ|ȂԂ̍ċA͍sȂ
+	int SuperQuickSortRec(T* array, size_t num, size_t lo, size_t hi)
 	{
 		T* alignedArray = (T*)(((size_t)array) + 31 & ~31);
 		size_t alignedSize = (array + num - alignedArray) & ~31;
@@ -1043,6 +987,10 @@ namespace {
 				for (i = 0; i + 2048 <= alignedSize; i += 2048)
 				{
 					int* ofsArray = (int*)alignedArray + i + 15;
+					if (i + 2048 * 2 <= alignedSize)
+					{
+						PrefetchSamples(ofsArray + 2048);
+					}
 					m0 = _mm256_i32gather_epi32(ofsArray + 256 * 0, index, 4);
 					m1 = _mm256_i32gather_epi32(ofsArray + 256 * 1, index, 4);
 					m2 = _mm256_i32gather_epi32(ofsArray + 256 * 2, index, 4);
@@ -1059,9 +1007,11 @@ namespace {
 						{
 							ofsArray[j * 32] = alignedArray[idx];
 							alignedArray[idx] = center;
-							if ((T*)ofsArray - 15 + j * 32 != alignedArray)
+							T* block = (T*)ofsArray - 15 + j * 32;
+							if (block != alignedArray)
 							{
-								SuperSort64((T*)ofsArray - 15 + j * 32);
+								// ̃ubN͔͈͊O󂳂Ȃ悤ÕubNƍ킹ă\[g
+								SuperSort64(block + 64 > alignedArray + alignedSize ? block - 32 : block);
 							}
 							idx++;
 							break;
@@ -1090,7 +1040,9 @@ namespace {
 			while (1)
 			{
 				Merge3232();
-				if (m3.m256i_i32[7] <= pivot)
+				// [̂܂܎c肪2ubNɂȂꍇ́A[̏
+				bool last = l + 32 == r;
+				if (m3.m256i_i32[7] <= pivot || (fracL && last))
 				{
 					Store32(l, m0, m1, m2, m3);
 					if (fracL && l == alignedArray)
@@ -1110,13 +1062,24 @@ namespace {
 						l += 32;
 						if (l == r)
 						{
-							Store32(r, m4, m5, m6, m7);
-							break;
+							if (!fracR)
+							{
+								Store32(r, m4, m5, m6, m7);
+								break;
+							}
+							l -= 32;
+						}
+						else
+						{
+							Load32(l, m0, m1, m2, m3);
+							if (r - l > SUPERQUICKSORT_PREFETCH_BLOCKS * 32)
+							{
+								Prefetch32(l + SUPERQUICKSORT_PREFETCH_BLOCKS * 32);
+							}
 						}
-						Load32(l, m0, m1, m2, m3);
 					}
 				}
-				if (m4.m256i_i32[0] >= pivot)
+				if (m4.m256i_i32[0] >= pivot || (fracR && last))
 				{
 					Store32(r, m4, m5, m6, m7);
 					if (fracR && r == alignedArray + alignedSize - 32)
@@ -1136,35 +1099,52 @@ namespace {
 						r -= 32;
 						if (l == r)
 						{
-							Store32(l, m0, m1, m2, m3);
-							break;
+							if (!fracL)
+							{
+								Store32(l, m0, m1, m2, m3);
+								break;
+							}
+							r += 32;
+						}
+						else
+						{
+							Load32(r, m4, m5, m6, m7);
+							if (r - l > SUPERQUICKSORT_PREFETCH_BLOCKS * 32)
+							{
+								Prefetch32(r - SUPERQUICKSORT_PREFETCH_BLOCKS * 32);
+							}
 						}
-						Load32(r, m4, m5, m6, m7);
 					}
 				}
 			}
 			assert(!(fracL || fracR));
 			int lfrac = 0, rfrac = 0;
-			if (rightFraction)
+			size_t ofs = l - array;
+			bool needL = lo < ofs + 32;
+			bool needR = ofs < hi;
+			if (rightFraction && needR)
 			{
-				rfrac = SuperQuickSortRec(l, array - l + num);
+				rfrac = SuperQuickSortRec(l, array - l + num, lo > ofs ? lo - ofs : 0, hi - ofs);
 			}
 			if (leftFraction)
 			{
-				lfrac = SuperQuickSortRec(array, (r + 32) - array);
+				if (needL)
+				{
+					lfrac = SuperQuickSortRec(array, (r + 32) - array, lo, hi);
+				}
 			}
 			else
 			{
-				if (r != array)
+				if (r != array && needL)
 				{
-					SuperQuickSortRecAligned(array, (r + 32) - array);
+					SuperQuickSortRecAligned(array, (r + 32) - array, lo, hi);
 				}
 			}
-			if (!rightFraction)
+			if (!rightFraction && needR)
 			{
 				if (l != array + num - 32)
 				{
-					SuperQuickSortRecAligned(l, array - l + num);
+					SuperQuickSortRecAligned(l, array - l + num, lo > ofs ? lo - ofs : 0, hi - ofs);
 				}
 			}
 			return lfrac + rfrac;
@@ -1174,12 +1154,17 @@ namespace {
 	}
 
 	// 128vf̃\[g
-	void SuperSortSmall(T* array, size_t num)
+	// buf32vfACgꂽ128vf̍Ɨ̈
+	void SuperSortSmall(T* array, size_t num, T* buf)
 	{
+		if (num <= 32)
+		{
+			// 32vfȉ̓WX^̃lbg[Nōς܂
+			SuperSortTiny(array, num);
+			return;
+		}
 		bool isAligned = (((size_t)array) & 31) == 0;
 		size_t alignedsize;
-		T stackArray[135];
-		T* buf = (T*)(((size_t)stackArray) + 31 & ~31);
 
 		if (num < 64)
 		{
@@ -1189,14 +1174,22 @@ namespace {
 		else
 		{
 			// 32vfACgɒ
-			alignedsize = (num - 1 | 31) + 1;
+			alignedsize = ((num - 1) | 31) + 1;
 		}
-		size_t i;
-		for (i = num; i < alignedsize; i++)
+		if (isAligned && num == alignedsize)
+		{
+			// pfBOsvȏꍇ͂̏Ń\[g
+			buf = array;
+		}
+		else
 		{
-			buf[i] = PADDING_MAX;
+			size_t i;
+			for (i = num; i < alignedsize; i++)
+			{
+				buf[i] = PADDING_MAX;
+			}
+			memcpy(buf, array, sizeof(T) * num);
 		}
-		memcpy(buf, array, sizeof(T) * num);
 		if (alignedsize == 64)
 		{
 			SuperSort64(buf);
@@ -1232,60 +1225,266 @@ namespace {
 			Store32(buf + 32, m0, m1, m2, m3);
 			Store32(buf + 64, m4, m5, m6, m7);
 		}
-		memcpy(array, buf, sizeof(T) * num);
+		if (buf != array)
+		{
+			memcpy(array, buf, sizeof(T) * num);
+		}
+	}
+
+	void SuperSortSmall(T* array, size_t num)
+	{
+		T stackArray[135];
+		SuperSortSmall(array, num, (T*)(((size_t)stackArray + 31) & ~(size_t)31));
+	}
+} // namespace
+
+namespace {
+	// [lo, hi)͈̗̔͂vf\[gς݂̈ʒuɊm肳
+	void SuperQuickSortRange(T* array, size_t num, size_t lo, size_t hi)
+	{
+		if (((size_t)array) & 3)
+		{
+			// 4oCgACgᔽ
+			abort();
+		}
+		if (num <= 128)
+		{
+			// 128vf̎͐p̃[`gp
+			SuperSortSmall(array, num);
+		}
+		else if (lo < hi)
+		{
+			T* alignedArray = (T*)(((size_t)array + 31) & ~(size_t)31);
+			size_t alignedSize = (array + num - alignedArray) & ~63;
+			size_t i;
+			int leftFraction = (int)(alignedArray - array);
+			int rightFraction = (int)(num - alignedSize - leftFraction);
+			int frac;
+			for (i = 0; i * 64 < alignedSize; i++)
+			{
+				SuperSort3232(alignedArray + i * 64);
+			}
+			if (rightFraction >= 32)
+			{
+				SuperSort3232(alignedArray + alignedSize - 32);
+				rightFraction -= 32;
+			}
+			if (leftFraction || rightFraction)
+			{
+				frac = SuperQuickSortRec(array, num, lo, hi);
+			}
+			else
+			{
+				SuperQuickSortRecAligned(array, num, lo, hi);
+			}
+			if (leftFraction && lo < (size_t)(frac >> 16))
+			{
+				int n = (frac >> 16);
+				SuperSortSmall(array, n);
+				//SuperQuickSortEnd(array, n);
+			}
+			if (rightFraction && num - (frac & 65535) < hi)
+			{
+				int n = (frac & 65535);
+				SuperSortSmall(array + num - n, n);
+				//SuperQuickSortEnd(array + (num - n), n);
+			}
+		}
 	}
 } // namespace
 
 // SuperQuickSort{
 void SuperQuickSort(T* array, size_t num)
 {
-	if (((size_t)array) & 3)
-	{
-		// 4oCgACgᔽ
-		abort();
-	}
-	if (num <= 128)
+	SuperQuickSortRange(array, num, 0, num);
+}
+
+// \[gB擪kvf݂̂\[gς݂ɂAc͏skvfڈȍ~ɒu
+void SuperPartialSort(T* array, size_t num, size_t k)
+{
+	SuperQuickSortRange(array, num, 0, k < num ? k : num);
+}
+
+// nthԖڂ̗vf\[gς݂̈ʒuɒuAOɂȉAɂȏ̗vfW߂
+void SuperNthElement(T* array, size_t num, size_t nth)
+{
+	if (nth < num)
 	{
-		// 128vf̎͐p̃[`gp
-		SuperSortSmall(array, num);
+		SuperQuickSortRange(array, num, nth, nth + 1);
 	}
-	else
+}
+
+namespace {
+	// ob`\[g̍Ə
+	// 32vfȉ̔z̓lbg[N̑傫ɒ߁A܂Ƃ߂ă\[gĊez̔ȓ҂d˂
+	// 128vfȉ͋L̍Ɨ̈SuperSortSmallA傫zSuperQuickSort1
+	class BatchSorter
 	{
-		T* alignedArray = (T*)(((size_t)array) + 31 & ~31);
-		size_t alignedSize = (array + num - alignedArray) & ~63;
-		size_t i;
-		int leftFraction = (int)(alignedArray - array);
-		int rightFraction = (int)(num - alignedSize - leftFraction);
-		int frac;
-		for (i = 0; i * 64 < alignedSize; i++)
+	public:
+		BatchSorter()
 		{
-			SuperSort3232(alignedArray + i * 64);
+			m_buf = (T*)(((size_t)m_stack + 31) & ~31);
+			m_count[0] = m_count[1] = m_count[2] = 0;
 		}
-		if (rightFraction >= 32)
+		void Sort(T* array, size_t num)
 		{
-			SuperSort3232(alignedArray + alignedSize - 32);
-			rightFraction -= 32;
+			if (num < 2)
+			{
+				return;
+			}
+			if (num <= 8)
+			{
+				Push<1, 4>(0, array, num);
+			}
+			else if (num <= 16)
+			{
+				Push<2, 4>(1, array, num);
+			}
+			else if (num <= 32)
+			{
+				Push<4, 2>(2, array, num);
+			}
+			else if (num <= 128)
+			{
+				SuperSortSmall(array, num, m_buf);
+			}
+			else
+			{
+				SuperQuickSort(array, num);
+			}
 		}
-		if (leftFraction || rightFraction)
+		// 킸Ɏcz1\[g
+		void Finish()
 		{
-			frac = SuperQuickSortRec(array, num);
+			size_t i;
+			for (i = 0; i < m_count[0]; i++)
+			{
+				SuperSortNet<1>(m_arrays[0][i], m_nums[0][i]);
+			}
+			for (i = 0; i < m_count[1]; i++)
+			{
+				SuperSortNet<2>(m_arrays[1][i], m_nums[1][i]);
+			}
+			for (i = 0; i < m_count[2]; i++)
+			{
+				SuperSortNet<4>(m_arrays[2][i], m_nums[2][i]);
+			}
+			m_count[0] = m_count[1] = m_count[2] = 0;
 		}
-		else
+
+	private:
+		template<int R, int G>
+		void Push(int q, T* array, size_t num)
+		{
+			m_arrays[q][m_count[q]] = array;
+			m_nums[q][m_count[q]] = num;
+			if (++m_count[q] == G)
+			{
+				SuperSortNetGroup<R, G>(m_arrays[q], m_nums[q]);
+				m_count[q] = 0;
+			}
+		}
+
+		T* m_arrays[3][4];
+		size_t m_nums[3][4];
+		size_t m_count[3];
+		T m_stack[135];
+		T* m_buf;
+	};
+
+	// Ƀ\[gzǂ݂Ă
+	void SuperSortBatchPrefetch(const T* array, size_t num)
+	{
+		size_t i;
+		for (i = 0; i < num && i < 128; i += 16)
 		{
-			SuperQuickSortRecAligned(array, num);
+			_mm_prefetch((const char*)(array + i), _MM_HINT_T0);
 		}
-		if (leftFraction)
+	}
+} // namespace
+
+// Ɨ̔zꂼ\[g
+void SuperSortBatch(T** arrays, const size_t* lens, size_t count)
+{
+	BatchSorter sorter;
+	size_t i;
+	for (i = 0; i < count; i++)
+	{
+		if (i + 1 < count)
 		{
-			int n = (frac >> 16);
-			SuperSortSmall(array, n);
-			//SuperQuickSortEnd(array, n);
+			SuperSortBatchPrefetch(arrays[i + 1], lens[i + 1]);
 		}
-		if (rightFraction)
+		sorter.Sort(arrays[i], lens[i]);
+	}
+	sorter.Finish();
+}
+
+// values[offsets[i]]values[offsets[i + 1]]܂ł̊eԂꂼ\[g
+void SuperSortBatch(T* values, const size_t* offsets, size_t count)
+{
+	BatchSorter sorter;
+	size_t i;
+	for (i = 0; i < count; i++)
+	{
+		if (i + 1 < count)
 		{
-			int n = (frac & 65535);
-			SuperSortSmall(array + num - n, n);
-			//SuperQuickSortEnd(array + (num - n), n);
+			SuperSortBatchPrefetch(values + offsets[i + 1], offsets[i + 2] - offsets[i + 1]);
 		}
+		sorter.Sort(values + offsets[i], offsets[i + 1] - offsets[i]);
+	}
+	sorter.Finish();
+}
+
+// CSR`̊eԂꂼ\[g
+// Ԃ̓WX^̃\[eBOlbg[NA傫ԂSuperQuickSortŏA
+// Ԃ̕тvfłقڋϓȃ`NɕĕXbhŏ
+void SuperSegmentedSort(T* values, const size_t* offsets, size_t segments, int threads)
+{
+	// 1`N̗vf̖ڈ
+	const size_t CHUNK_SIZE = 1 << 16;
+	size_t total = offsets[segments] - offsets[0];
+	if (threads <= 0)
+	{
+		threads = (int)std::thread::hardware_concurrency();
+	}
+	if (threads <= 1 || total < CHUNK_SIZE * 2)
+	{
+		SuperSortBatch(values, offsets, segments);
+		return;
+	}
+	SuperSortVector<size_t> chunks;
+	size_t i;
+	chunks.push_back(0);
+	for (i = 1; i < segments; i++)
+	{
+		if (offsets[i] - offsets[chunks.back()] >= CHUNK_SIZE)
+		{
+			chunks.push_back(i);
+		}
+	}
+	chunks.push_back(segments);
+	if ((size_t)threads > chunks.size() - 1)
+	{
+		threads = (int)(chunks.size() - 1);
+	}
+	std::atomic<size_t> next(0);
+	auto worker = [&]() {
+		size_t c;
+		while ((c = next++) < chunks.size() - 1)
+		{
+			SuperSortBatch(values, offsets + chunks[c], chunks[c + 1] - chunks[c]);
+		}
+	};
+	SuperSortScratchContext scratch;
+	SuperSortVector<std::thread> pool;
+	for (i = 1; i < (size_t)threads; i++)
+	{
+		pool.emplace_back([&scratch, &worker]() { SuperSortScratchScope scope(scratch); worker(); });
+	}
+	worker();
+	for (auto& t : pool)
+	{
+		t.join();
 	}
 }
 #if 0
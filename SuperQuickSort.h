@@ -17,3 +17,13 @@
 
 void SuperQuickSort(int* array, size_t num);
 void SuperQuickSort(unsigned int* array, size_t num);
+void SuperPartialSort(int* array, size_t num, size_t k);
+void SuperPartialSort(unsigned int* array, size_t num, size_t k);
+void SuperNthElement(int* array, size_t num, size_t nth);
+void SuperNthElement(unsigned int* array, size_t num, size_t nth);
+void SuperSortBatch(int** arrays, const size_t* lens, size_t count);
+void SuperSortBatch(unsigned int** arrays, const size_t* lens, size_t count);
+void SuperSortBatch(int* values, const size_t* offsets, size_t count);
+void SuperSortBatch(unsigned int* values, const size_t* offsets, size_t count);
+void SuperSegmentedSort(int* values, const size_t* offsets, size_t segments, int threads = 0);
+void SuperSegmentedSort(unsigned int* values, const size_t* offsets, size_t segments, int threads = 0);
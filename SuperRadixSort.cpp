@@ -0,0 +1,386 @@
+/*
+	Copyright 2018 Toshihiro Shirakawa
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#include <stdio.h>
+#include <memory.h>
+#include <immintrin.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include "SuperSort.h"
+#include "SuperSortVector.h"
+#include "SuperQuickSort.h"
+#include "SuperRadixSort.h"
+
+#ifdef SUPERRADIXSORT_UNSIGNED
+typedef unsigned int T;
+// ̎oɕrbg𔽓]ĕȂ̏ɑ
+const unsigned int SIGN_FLIP = 0;
+#else
+typedef int T;
+const unsigned int SIGN_FLIP = 0x80000000U;
+#endif
+
+// SuperSortAuto̐؂ւ_
+// ̗vfȉSuperQuickSort
+#ifndef SUPERSORTAUTO_SMALL
+#define SUPERSORTAUTO_SMALL 128
+#endif
+// LȌ2ȉ̏ꍇ̗͂vfȏŊ\[g
+#ifndef SUPERSORTAUTO_RADIX_NARROW
+#define SUPERSORTAUTO_RADIX_NARROW (1 << 23)
+#endif
+// LȌ3̏ꍇ̗͂vfȏŊ\[g
+// 4ׂĂgz̓pXSuperSortɏĂȂ̂ŗvfɊւ炸SuperSort
+#ifndef SUPERSORTAUTO_RADIX
+#define SUPERSORTAUTO_RADIX (1 << 27)
+#endif
+
+// SuperSortHybrid1oPbg̗vf̖ڈ(L2Ɏ܂傫)
+#ifndef SUPERSORTHYBRID_BUCKET
+#define SUPERSORTHYBRID_BUCKET (1 << 16)
+#endif
+
+namespace {
+	const int RADIX_BITS = 8;
+	const int RADIX = 1 << RADIX_BITS;
+	const int PASSES = 32 / RADIX_BITS;
+	// ݌obt@1oPbg̗vf(1LbVC)
+	const int WC_SIZE = 64 / sizeof(T);
+
+	// S̃qXgO1pXō
+	// AVX2ɂ̓XLb^ZȂ߁A[hƕ]SIMDōs
+	void Histogram(const T* array, size_t num, size_t hist[PASSES][RADIX])
+	{
+		__m256i flip = _mm256_set1_epi32(SIGN_FLIP);
+		alignas(32) unsigned int key[8];
+		size_t i;
+		int j;
+		for (i = 0; i + 8 <= num; i += 8)
+		{
+			_mm256_store_si256((__m256i*)key, _mm256_xor_si256(_mm256_loadu_si256((__m256i*)(array + i)), flip));
+			for (j = 0; j < 8; j++)
+			{
+				hist[0][key[j] & (RADIX - 1)]++;
+				hist[1][key[j] >> 8 & (RADIX - 1)]++;
+				hist[2][key[j] >> 16 & (RADIX - 1)]++;
+				hist[3][key[j] >> 24]++;
+			}
+		}
+		for (; i < num; i++)
+		{
+			unsigned int k = (unsigned int)array[i] ^ SIGN_FLIP;
+			hist[0][k & (RADIX - 1)]++;
+			hist[1][k >> 8 & (RADIX - 1)]++;
+			hist[2][k >> 16 & (RADIX - 1)]++;
+			hist[3][k >> 24]++;
+		}
+	}
+
+	// shiftrbgڂ̌srcdstɐU蕪
+	// eoPbg̗vfwc1LbVC߂Ă܂Ƃ߂ďo
+	void Scatter(const T* src, T* dst, size_t num, int shift, size_t* offset, T* wc)
+	{
+		unsigned int fill[RADIX] = {};
+		size_t i;
+		int d;
+		for (i = 0; i < num; i++)
+		{
+			d = ((unsigned int)src[i] ^ SIGN_FLIP) >> shift & (RADIX - 1);
+			T* bucket = wc + d * WC_SIZE;
+			bucket[fill[d]++] = src[i];
+			if (fill[d] == WC_SIZE)
+			{
+				_mm256_storeu_si256((__m256i*)(dst + offset[d]), _mm256_load_si256((__m256i*)bucket));
+				_mm256_storeu_si256((__m256i*)(dst + offset[d] + 8), _mm256_load_si256((__m256i*)(bucket + 8)));
+				offset[d] += WC_SIZE;
+				fill[d] = 0;
+			}
+		}
+		for (d = 0; d < RADIX; d++)
+		{
+			memcpy(dst + offset[d], wc + d * WC_SIZE, sizeof(T) * fill[d]);
+		}
+	}
+
+	// W{̍ŏlƍől̍A\[gŕKvɂȂ錅ς
+	int EstimatePasses(const T* array, size_t num)
+	{
+		size_t step = num / 1024 + 1;
+		unsigned int lo = 0xFFFFFFFFU, hi = 0;
+		size_t i;
+		for (i = 0; i < num; i += step)
+		{
+			unsigned int k = (unsigned int)array[i] ^ SIGN_FLIP;
+			lo = k < lo ? k : lo;
+			hi = k > hi ? k : hi;
+		}
+		if (lo == hi)
+		{
+			return 0;
+		}
+		return (31 - (int)_lzcnt_u32(lo ^ hi)) / RADIX_BITS + 1;
+	}
+} // namespace
+
+// 8rbg4LSD\[g
+// SvflɂȂ錅̃pX͏ȗBvf̃[LOKvƂ
+void SuperRadixSort(T* array, size_t num)
+{
+	if (num < 2)
+	{
+		return;
+	}
+	size_t hist[PASSES][RADIX] = {};
+	Histogram(array, num, hist);
+
+	T* buf = (T*)AlignedMalloc(sizeof(T) * num);
+	T* wc = (T*)AlignedMalloc(sizeof(T) * RADIX * WC_SIZE);
+	T* src = array;
+	T* dst = buf;
+	unsigned int first = (unsigned int)array[0] ^ SIGN_FLIP;
+	int p;
+	for (p = 0; p < PASSES; p++)
+	{
+		int shift = p * RADIX_BITS;
+		if (hist[p][first >> shift & (RADIX - 1)] == num)
+		{
+			continue;
+		}
+		size_t offset[RADIX];
+		size_t sum = 0;
+		int d;
+		for (d = 0; d < RADIX; d++)
+		{
+			offset[d] = sum;
+			sum += hist[p][d];
+		}
+		Scatter(src, dst, num, shift, offset, wc);
+		T* t = src;
+		src = dst;
+		dst = t;
+	}
+	if (src != array)
+	{
+		memcpy(array, src, sizeof(T) * num);
+	}
+	AlignedFree(wc);
+	AlignedFree(buf);
+}
+
+// vfƒl̕zSuperQuickSortASuperSortASuperRadixSortIŃ\[g
+void SuperSortAuto(T* array, size_t num)
+{
+	if (num <= SUPERSORTAUTO_SMALL)
+	{
+		SuperQuickSort(array, num);
+	}
+	else if (num < SUPERSORTAUTO_RADIX_NARROW)
+	{
+		SuperSort(array, num);
+	}
+	else
+	{
+		int passes = EstimatePasses(array, num);
+		if (passes <= 2 || (passes <= 3 && num >= SUPERSORTAUTO_RADIX))
+		{
+			SuperRadixSort(array, num);
+		}
+		else
+		{
+			SuperSort(array, num);
+		}
+	}
+}
+
+namespace {
+	// MSD̐U蕪Ɏgő̌
+	const int HYBRID_MAX_BITS = 11;
+
+	// vfoPbǧ߂
+	int HybridBits(size_t num)
+	{
+		int bits = 1;
+		while (bits < HYBRID_MAX_BITS && ((size_t)SUPERSORTHYBRID_BUCKET << bits) < num)
+		{
+			bits++;
+		}
+		return bits;
+	}
+
+	// L[͈̔͂rangêƂAbitsrbgoVtg
+	int HybridShift(unsigned int range, int bits)
+	{
+		int width = range ? 32 - (int)_lzcnt_u32(range) : 0;
+		return width > bits ? width - bits : 0;
+	}
+
+	void MinMaxKey(const T* array, size_t num, unsigned int& lo, unsigned int& hi)
+	{
+		size_t i;
+		lo = 0xFFFFFFFFU;
+		hi = 0;
+		for (i = 0; i < num; i++)
+		{
+			unsigned int k = (unsigned int)array[i] ^ SIGN_FLIP;
+			lo = k < lo ? k : lo;
+			hi = k > hi ? k : hi;
+		}
+	}
+
+	// srcʂ̌dstɐU蕪AeoPbgdstSuperQuickSort
+	void HybridSortTo(const T* src, T* dst, size_t num)
+	{
+		unsigned int lo, hi;
+		MinMaxKey(src, num, lo, hi);
+		int shift = HybridShift(hi - lo, HybridBits(num));
+		size_t buckets = ((size_t)(hi - lo) >> shift) + 1;
+		SuperSortVector<size_t> offset(buckets + 1);
+		size_t i;
+		for (i = 0; i < num; i++)
+		{
+			offset[((((unsigned int)src[i] ^ SIGN_FLIP) - lo) >> shift) + 1]++;
+		}
+		for (i = 0; i < buckets; i++)
+		{
+			offset[i + 1] += offset[i];
+		}
+		SuperSortVector<size_t> pos(offset.begin(), offset.end() - 1);
+		for (i = 0; i < num; i++)
+		{
+			dst[pos[(((unsigned int)src[i] ^ SIGN_FLIP) - lo) >> shift]++] = src[i];
+		}
+		for (i = 0; i < buckets; i++)
+		{
+			SuperQuickSort(dst + offset[i], offset[i + 1] - offset[i]);
+		}
+	}
+} // namespace
+
+// MSDL2Ɏ܂傫̃oPbgɕĂAoPbgSuperQuickSort
+// U蕪̓Xbh̃qXgOŕɍsAoPbg̃\[gXbhԂŕS
+// 傫oPbg͂1iU蕪Bvf̃[LOKvƂ
+void SuperSortHybrid(T* array, size_t num, int threads)
+{
+	if (threads <= 0)
+	{
+		threads = (int)std::thread::hardware_concurrency();
+	}
+	if (threads < 1)
+	{
+		threads = 1;
+	}
+	if (num < (size_t)SUPERSORTHYBRID_BUCKET * 2)
+	{
+		SuperQuickSort(array, num);
+		return;
+	}
+	if ((size_t)threads > num / SUPERSORTHYBRID_BUCKET)
+	{
+		threads = (int)(num / SUPERSORTHYBRID_BUCKET);
+	}
+
+	auto run = [&](auto&& work) {
+		SuperSortScratchContext scratch;
+		SuperSortVector<std::thread> pool;
+		int t;
+		for (t = 1; t < threads; t++)
+		{
+			pool.emplace_back([&scratch, &work](int i) { SuperSortScratchScope scope(scratch); work(i); }, t);
+		}
+		work(0);
+		for (auto& th : pool)
+		{
+			th.join();
+		}
+	};
+	auto begin = [&](int t) { return num * t / threads; };
+
+	// L[͈̔
+	SuperSortVector<unsigned int> los(threads), his(threads);
+	run([&](int t) {
+		MinMaxKey(array + begin(t), begin(t + 1) - begin(t), los[t], his[t]);
+	});
+	unsigned int lo = los[0], hi = his[0];
+	int t;
+	for (t = 1; t < threads; t++)
+	{
+		lo = los[t] < lo ? los[t] : lo;
+		hi = his[t] > hi ? his[t] : hi;
+	}
+	if (lo == hi)
+	{
+		return;
+	}
+	int shift = HybridShift(hi - lo, HybridBits(num));
+	size_t buckets = ((size_t)(hi - lo) >> shift) + 1;
+
+	// Xbh̃qXgO
+	SuperSortVector<size_t> hist(buckets * threads);
+	run([&](int t) {
+		size_t* h = &hist[buckets * t];
+		size_t i;
+		for (i = begin(t); i < begin(t + 1); i++)
+		{
+			h[(((unsigned int)array[i] ^ SIGN_FLIP) - lo) >> shift]++;
+		}
+	});
+	// oPbgAXbhɏ݈ʒu蓖Ă
+	SuperSortVector<size_t> bound(buckets + 1);
+	size_t sum = 0;
+	size_t b;
+	for (b = 0; b < buckets; b++)
+	{
+		bound[b] = sum;
+		for (t = 0; t < threads; t++)
+		{
+			size_t n = hist[buckets * t + b];
+			hist[buckets * t + b] = sum;
+			sum += n;
+		}
+	}
+	bound[buckets] = sum;
+
+	T* buf = (T*)AlignedMalloc(sizeof(T) * num);
+	run([&](int t) {
+		size_t* pos = &hist[buckets * t];
+		size_t i;
+		for (i = begin(t); i < begin(t + 1); i++)
+		{
+			buf[pos[(((unsigned int)array[i] ^ SIGN_FLIP) - lo) >> shift]++] = array[i];
+		}
+	});
+
+	// oPbg̃\[gBLbVɍڂĂԂɌ̔z֏߂
+	std::atomic<size_t> next(0);
+	run([&](int) {
+		size_t b;
+		while ((b = next++) < buckets)
+		{
+			size_t n = bound[b + 1] - bound[b];
+			if (n > (size_t)SUPERSORTHYBRID_BUCKET * 4)
+			{
+				HybridSortTo(buf + bound[b], array + bound[b], n);
+			}
+			else
+			{
+				SuperQuickSort(buf + bound[b], n);
+				memcpy(array + bound[b], buf + bound[b], sizeof(T) * n);
+			}
+		}
+	});
+	AlignedFree(buf);
+}
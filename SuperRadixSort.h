@@ -0,0 +1,23 @@
+/*
+	Copyright 2018 Toshihiro Shirakawa
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#pragma once
+
+void SuperRadixSort(int* array, size_t num);
+void SuperRadixSort(unsigned int* array, size_t num);
+void SuperSortAuto(int* array, size_t num);
+void SuperSortAuto(unsigned int* array, size_t num);
+void SuperSortHybrid(int* array, size_t num, int threads = 0);
+void SuperSortHybrid(unsigned int* array, size_t num, int threads = 0);
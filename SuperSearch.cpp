@@ -0,0 +1,179 @@
+﻿/*
+	Copyright 2018 Toshihiro Shirakawa
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#include <stdio.h>
+#include <immintrin.h>
+#include <algorithm>
+#include <limits>
+
+#include "SuperSearch.h"
+
+#ifdef SUPERSEARCH_UNSIGNED
+typedef unsigned int T;
+const T PADDING_MAX = 0xFFFFFFFFU;
+// 比較は符号付きで行うので、符号ビットを反転して符号なしの順序に合わせる
+const int COMPARE_FLIP = (int)0x80000000U;
+#else
+typedef int T;
+const T PADDING_MAX = 0x7FFFFFFF;
+const int COMPARE_FLIP = 0;
+#endif
+
+namespace {
+	// 17分木の子の番号
+	size_t Child(size_t k, int i)
+	{
+		return k * 17 + i + 1;
+	}
+
+	__m256i Flip(__m256i m)
+	{
+		return _mm256_xor_si256(m, _mm256_set1_epi32(COMPARE_FLIP));
+	}
+
+	// ノード内のx未満のキーの数。ノード内は昇順なので、比較結果のビット数がそのまま位置になる
+	int NodeRank(const T* node, __m256i x)
+	{
+		__m256i lt0 = _mm256_cmpgt_epi32(x, Flip(_mm256_load_si256((const __m256i*)(node + 0))));
+		__m256i lt1 = _mm256_cmpgt_epi32(x, Flip(_mm256_load_si256((const __m256i*)(node + 8))));
+		unsigned int mask = _mm256_movemask_ps(_mm256_castsi256_ps(lt0)) | _mm256_movemask_ps(_mm256_castsi256_ps(lt1)) << 8;
+		return _mm_popcnt_u32(mask);
+	}
+
+	// 木を中順に辿り、ソート済みの配列の要素を順に詰める。余りはPADDING_MAXで埋める
+	void BuildNode(const T* array, size_t num, T* keys, size_t* index, size_t nodes, size_t k, size_t& t)
+	{
+		if (k >= nodes)
+		{
+			return;
+		}
+		int i;
+		for (i = 0; i < 16; i++)
+		{
+			BuildNode(array, num, keys, index, nodes, Child(k, i), t);
+			keys[k * 16 + i] = t < num ? array[t] : PADDING_MAX;
+			index[k * 16 + i] = t < num ? t : num;
+			if (t < num)
+			{
+				t++;
+			}
+		}
+		BuildNode(array, num, keys, index, nodes, Child(k, 16), t);
+	}
+
+	// 8クエリの二分探索の1段。base + halfの要素がx未満のレーンだけbaseをhalf進める
+	__m256i LowerBoundStep(const T* array, __m256i x, __m256i base, size_t half)
+	{
+		__m256i h = _mm256_set1_epi32((int)half);
+		__m256i probe = Flip(_mm256_i32gather_epi32((const int*)array, _mm256_add_epi32(base, h), 4));
+		return _mm256_add_epi32(base, _mm256_and_si256(_mm256_cmpgt_epi32(x, probe), h));
+	}
+} // namespace
+
+void SuperLowerBound(const T* array, size_t num, const T* queries, size_t count, size_t* result)
+{
+	size_t q = 0;
+	// ギャザーの添字は32ビット
+	if (num && num <= 0x7FFFFFFF)
+	{
+		for (; q + 32 <= count; q += 32)
+		{
+			__m256i x[4], base[4];
+			int v;
+			for (v = 0; v < 4; v++)
+			{
+				x[v] = Flip(_mm256_loadu_si256((const __m256i*)(queries + q + v * 8)));
+				base[v] = _mm256_setzero_si256();
+			}
+			// 要素数が同じなので全レーンが同じ回数だけ範囲を半分に絞る
+			// 4組の探索を交互に進め、ギャザーのメモリアクセスを重ねる
+			size_t n = num;
+			while (n > 1)
+			{
+				size_t half = n / 2;
+				for (v = 0; v < 4; v++)
+				{
+					base[v] = LowerBoundStep(array, x[v], base[v], half);
+				}
+				n -= half;
+			}
+			// 最後に残った要素がx未満なら1つ進める
+			for (v = 0; v < 4; v++)
+			{
+				__m256i probe = Flip(_mm256_i32gather_epi32((const int*)array, base[v], 4));
+				base[v] = _mm256_sub_epi32(base[v], _mm256_cmpgt_epi32(x[v], probe));
+				_mm256_storeu_si256((__m256i*)(result + q + v * 8 + 0), _mm256_cvtepu32_epi64(_mm256_castsi256_si128(base[v])));
+				_mm256_storeu_si256((__m256i*)(result + q + v * 8 + 4), _mm256_cvtepu32_epi64(_mm256_extracti128_si256(base[v], 1)));
+			}
+		}
+	}
+	for (; q < count; q++)
+	{
+		result[q] = std::lower_bound(array, array + num, queries[q]) - array;
+	}
+}
+
+void SuperSearchTreeBuild(const T* array, size_t num, T* keys, size_t* index)
+{
+	size_t t = 0;
+	BuildNode(array, num, keys, index, (num + 15) / 16, 0, t);
+}
+
+void SuperSearchTreeLowerBound(const T* keys, const size_t* index, size_t num, const T* queries, size_t count, size_t* result)
+{
+	const int BATCH = 16;
+	size_t nodes = (num + 15) / 16;
+	size_t q;
+	for (q = 0; q < count; q += BATCH)
+	{
+		int g, n = count - q < (size_t)BATCH ? (int)(count - q) : BATCH;
+		size_t k[BATCH], best[BATCH];
+		__m256i x[BATCH];
+		for (g = 0; g < n; g++)
+		{
+			k[g] = 0;
+			best[g] = (size_t)-1;
+			x[g] = Flip(_mm256_set1_epi32((int)queries[q + g]));
+		}
+		// 全クエリを1段ずつ進め、次に読むノードを先読みしておく
+		bool active = nodes > 0;
+		while (active)
+		{
+			active = false;
+			for (g = 0; g < n; g++)
+			{
+				if (k[g] >= nodes)
+				{
+					continue;
+				}
+				int i = NodeRank(keys + k[g] * 16, x[g]);
+				if (i < 16)
+				{
+					best[g] = k[g] * 16 + i;
+				}
+				k[g] = Child(k[g], i);
+				if (k[g] < nodes)
+				{
+					_mm_prefetch((const char*)(keys + k[g] * 16), _MM_HINT_T0);
+					active = true;
+				}
+			}
+		}
+		for (g = 0; g < n; g++)
+		{
+			result[q + g] = best[g] == (size_t)-1 ? num : index[best[g]];
+		}
+	}
+}
@@ -0,0 +1,77 @@
+﻿/*
+	Copyright 2018 Toshihiro Shirakawa
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#pragma once
+// ソート済みの配列に対する多数のlower_boundをまとめて行う
+// 結果はstd::lower_boundと同じく、x以上の最初の要素の位置(無ければnum)
+
+#include <stddef.h>
+#include <memory>
+#include <vector>
+
+#include "SuperSortVector.h"
+
+// ソート済みの配列をそのまま二分探索する。8クエリずつギャザーで比較し、4組を交互に進める
+void SuperLowerBound(const int* array, size_t num, const int* queries, size_t count, size_t* result);
+void SuperLowerBound(const unsigned int* array, size_t num, const unsigned int* queries, size_t count, size_t* result);
+
+// 16キー(64バイト)のノードを17分木に並べた検索用の配置を作る
+// keysとindexにはそれぞれSuperSearchTreeSize(num)要素分の領域が必要。keysは64バイト境界に置くこと
+void SuperSearchTreeBuild(const int* array, size_t num, int* keys, size_t* index);
+void SuperSearchTreeBuild(const unsigned int* array, size_t num, unsigned int* keys, size_t* index);
+// SuperSearchTreeBuildで作った配置を辿る。次に読むノードを先読みしながら16クエリずつ進める
+void SuperSearchTreeLowerBound(const int* keys, const size_t* index, size_t num, const int* queries, size_t count, size_t* result);
+void SuperSearchTreeLowerBound(const unsigned int* keys, const size_t* index, size_t num, const unsigned int* queries, size_t count, size_t* result);
+
+inline size_t SuperSearchTreeSize(size_t num)
+{
+	return (num + 15) / 16 * 16;
+}
+
+// 検索用の配置を保持するクラス。元の配列は不要になる
+// 配置はAllocで確保する。Allocは64バイト境界に揃った領域を返す必要がある
+template<typename T, typename Alloc = SuperSortHeapAllocator<T>>
+class SuperSearchTree
+{
+	static_assert(sizeof(T) == 4, "SuperSearchTreeは32ビットの要素だけに対応する");
+
+public:
+	SuperSearchTree(const T* array, size_t num, const Alloc& alloc = Alloc())
+		: m_keys(SuperSearchTreeSize(num), alloc), m_index(SuperSearchTreeSize(num), IndexAlloc(alloc))
+	{
+		m_num = num;
+		SuperSearchTreeBuild(array, num, m_keys.data(), m_index.data());
+	}
+	SuperSearchTree(const SuperSearchTree&) = delete;
+	SuperSearchTree& operator=(const SuperSearchTree&) = delete;
+
+	size_t LowerBound(T x) const
+	{
+		size_t result;
+		SuperSearchTreeLowerBound(m_keys.data(), m_index.data(), m_num, &x, 1, &result);
+		return result;
+	}
+	void LowerBound(const T* queries, size_t count, size_t* result) const
+	{
+		SuperSearchTreeLowerBound(m_keys.data(), m_index.data(), m_num, queries, count, result);
+	}
+
+private:
+	typedef typename std::allocator_traits<Alloc>::template rebind_alloc<size_t> IndexAlloc;
+
+	std::vector<T, Alloc> m_keys;
+	std::vector<size_t, IndexAlloc> m_index;
+	size_t m_num;
+};
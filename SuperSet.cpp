@@ -0,0 +1,301 @@
+﻿/*
+	Copyright 2018 Toshihiro Shirakawa
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <immintrin.h>
+#include <algorithm>
+
+#include "SuperSet.h"
+
+#ifdef SUPERSET_UNSIGNED
+typedef unsigned int T;
+#define _mm256_max_epi32 _mm256_max_epu32
+#define _mm256_min_epi32 _mm256_min_epu32
+#else
+typedef int T;
+#endif
+
+// 長さの比がこれ以上なら、短い方の要素ごとに長い方を指数探索する
+#ifndef SUPERSET_GALLOP_RATIO
+#define SUPERSET_GALLOP_RATIO 32
+#endif
+
+namespace {
+	// maskのビットが立っているレーンの要素をdstに左詰めで格納し、格納した要素数を返す
+	// dstには常に8要素分書き込まれる
+	size_t LeftPack(T* dst, __m256i m, unsigned int mask)
+	{
+		unsigned long long bytemask = _pdep_u64(mask, 0x0101010101010101ULL) * 0xFF;
+		unsigned long long index = _pext_u64(0x0706050403020100ULL, bytemask);
+		__m256i perm = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128((long long)index));
+		_mm256_storeu_si256((__m256i*)dst, _mm256_permutevar8x32_epi32(m, perm));
+		return _mm_popcnt_u32(mask);
+	}
+
+	// aのレーンのうちbのどれかのレーンと等しいもののマスク。bを1レーンずつ回して8通りの組を比べる
+	unsigned int MatchMask(__m256i a, __m256i b)
+	{
+		const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+		__m256i eq = _mm256_cmpeq_epi32(a, b);
+		int i;
+		for (i = 1; i < 8; i++)
+		{
+			b = _mm256_permutevar8x32_epi32(b, rotate);
+			eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(a, b));
+		}
+		return _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+	}
+
+	// バイトニック列を昇順に並べる
+	__m256i BitonicClean(__m256i m)
+	{
+		__m256i t, lo, hi;
+		t = _mm256_permute2x128_si256(m, m, 0x01);
+		lo = _mm256_min_epi32(m, t);
+		hi = _mm256_max_epi32(m, t);
+		m = _mm256_blend_epi32(lo, hi, 0xF0);
+		t = _mm256_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2));
+		lo = _mm256_min_epi32(m, t);
+		hi = _mm256_max_epi32(m, t);
+		m = _mm256_blend_epi32(lo, hi, 0xCC);
+		t = _mm256_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1));
+		lo = _mm256_min_epi32(m, t);
+		hi = _mm256_max_epi32(m, t);
+		return _mm256_blend_epi32(lo, hi, 0xAA);
+	}
+
+	// 昇順の8要素同士をマージし、小さい方の8要素をlo、大きい方の8要素をhiに返す
+	void Merge88(__m256i& lo, __m256i& hi)
+	{
+		__m256i r = _mm256_permutevar8x32_epi32(hi, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+		hi = BitonicClean(_mm256_max_epi32(lo, r));
+		lo = BitonicClean(_mm256_min_epi32(lo, r));
+	}
+
+	// array[lo, num)の中でx以上の最初の位置を、loから1, 2, 4, ...と幅を広げて探す
+	size_t Gallop(const T* array, size_t lo, size_t num, T x)
+	{
+		size_t hi = lo, step = 1;
+		while (hi < num && array[hi] < x)
+		{
+			lo = hi + 1;
+			hi = lo + step;
+			step *= 2;
+		}
+		return std::lower_bound(array + lo, array + (hi < num ? hi : num), x) - array;
+	}
+
+	// Diffがfalseなら共通部分、trueならsrc1からsrc2を除いた差
+	template<bool Diff>
+	size_t Filter(const T* src1, size_t num1, const T* src2, size_t num2, T* dst)
+	{
+		size_t i = 0, j = 0, n = 0;
+		if (num1 >= 8 && num2 >= 8)
+		{
+			// 8要素ずつのブロックで、範囲の重なる組を全て比べる
+			// src1のブロックが一致したレーンを貯めておき、そのブロックを進める時に書き出す
+			__m256i m1 = _mm256_loadu_si256((const __m256i*)src1);
+			__m256i m2 = _mm256_loadu_si256((const __m256i*)src2);
+			unsigned int found = 0;
+			while (1)
+			{
+				found |= MatchMask(m1, m2);
+				T max1 = src1[i + 7], max2 = src2[j + 7];
+				if (max1 <= max2)
+				{
+					n += LeftPack(dst + n, m1, Diff ? ~found & 0xFF : found);
+					found = 0;
+					i += 8;
+					if (i + 8 > num1)
+					{
+						break;
+					}
+					m1 = _mm256_loadu_si256((const __m256i*)(src1 + i));
+				}
+				if (max2 <= max1)
+				{
+					j += 8;
+					if (j + 8 > num2)
+					{
+						break;
+					}
+					m2 = _mm256_loadu_si256((const __m256i*)(src2 + j));
+				}
+			}
+			// 書き出し途中のブロックは先頭からやり直す
+			j = i < num1 ? std::lower_bound(src2, src2 + num2, src1[i]) - src2 : num2;
+		}
+		if (Diff)
+		{
+			return n + (std::set_difference(src1 + i, src1 + num1, src2 + j, src2 + num2, dst + n) - (dst + n));
+		}
+		return n + (std::set_intersection(src1 + i, src1 + num1, src2 + j, src2 + num2, dst + n) - (dst + n));
+	}
+
+	// 短いsrc1の要素ごとにsrc2を指数探索する
+	template<bool Diff>
+	size_t FilterGallop(const T* src1, size_t num1, const T* src2, size_t num2, T* dst)
+	{
+		size_t i, j = 0, n = 0;
+		for (i = 0; i < num1; i++)
+		{
+			j = Gallop(src2, j, num2, src1[i]);
+			if ((j < num2 && src2[j] == src1[i]) != Diff)
+			{
+				dst[n++] = src1[i];
+			}
+		}
+		return n;
+	}
+
+	// 短いsrc2の要素ごとにsrc1を指数探索し、間の要素をまとめて写す
+	// Unionならsrc2の要素も書き込み、そうでなければsrc2の要素を取り除く
+	template<bool Union>
+	size_t CopyGallop(const T* src1, size_t num1, const T* src2, size_t num2, T* dst)
+	{
+		size_t i = 0, j, n = 0;
+		for (j = 0; j < num2; j++)
+		{
+			size_t k = Gallop(src1, i, num1, src2[j]);
+			memcpy(dst + n, src1 + i, sizeof(T) * (k - i));
+			n += k - i;
+			i = k;
+			if (i < num1 && src1[i] == src2[j])
+			{
+				i++;
+				if (!Union)
+				{
+					continue;
+				}
+			}
+			if (Union)
+			{
+				dst[n++] = src2[j];
+			}
+		}
+		memcpy(dst + n, src1 + i, sizeof(T) * (num1 - i));
+		return n + num1 - i;
+	}
+
+	// 8要素ずつマージし、直前の要素と等しいレーンを除いて書き出す
+	size_t MergeUnique(const T* src1, size_t num1, const T* src2, size_t num2, T* dst)
+	{
+		if (num1 < 8 || num2 < 8)
+		{
+			return std::set_union(src1, src1 + num1, src2, src2 + num2, dst) - dst;
+		}
+		const __m256i shift = _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6);
+		__m256i lo = _mm256_loadu_si256((const __m256i*)src1);
+		__m256i carry = _mm256_loadu_si256((const __m256i*)src2);
+		size_t i = 8, j = 8, n = 0;
+		while (1)
+		{
+			Merge88(lo, carry);
+			// 1レーンずらして直前の要素と比べる。先頭のレーンは前回書き出した最後の要素と比べる
+			__m256i prev = _mm256_permutevar8x32_epi32(lo, shift);
+			prev = _mm256_blend_epi32(prev, _mm256_set1_epi32(n ? dst[n - 1] : 0), 0x01);
+			unsigned int mask = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(lo, prev))) & 0xFF;
+			n += LeftPack(dst + n, lo, n ? mask : mask | 1);
+			// 次の要素が小さい方の列から読む。その列に8要素残っていなければ終わる
+			if (i < num1 && (j == num2 || src1[i] <= src2[j]))
+			{
+				if (i + 8 > num1)
+				{
+					break;
+				}
+				lo = _mm256_loadu_si256((const __m256i*)(src1 + i));
+				i += 8;
+			}
+			else
+			{
+				if (j + 8 > num2)
+				{
+					break;
+				}
+				lo = _mm256_loadu_si256((const __m256i*)(src2 + j));
+				j += 8;
+			}
+		}
+		// 8要素未満の端数はcarryと合わせ、長い方の残りとは指数探索でマージする
+		T small[24], work[24];
+		_mm256_storeu_si256((__m256i*)small, carry);
+		T* end = small + 8;
+		if (num1 - i < 8)
+		{
+			end = std::copy(work, std::merge(small, end, src1 + i, src1 + num1, work), small);
+			i = num1;
+		}
+		if (num2 - j < 8)
+		{
+			end = std::copy(work, std::merge(small, end, src2 + j, src2 + num2, work), small);
+			j = num2;
+		}
+		const T* rest = i < num1 ? src1 + i : src2 + j;
+		size_t restnum = i < num1 ? num1 - i : num2 - j;
+		// どちらも直前に書き出した要素以上なので、等しい場合は先頭だけを除けばよい
+		end = std::unique(small, end);
+		T* begin = small;
+		if (*begin == dst[n - 1])
+		{
+			begin++;
+		}
+		if (restnum && *rest == dst[n - 1])
+		{
+			rest++;
+			restnum--;
+		}
+		return n + CopyGallop<true>(rest, restnum, begin, end - begin, dst + n);
+	}
+} // namespace
+
+size_t SuperIntersect(const T* src1, size_t num1, const T* src2, size_t num2, T* dst)
+{
+	if (num1 * SUPERSET_GALLOP_RATIO <= num2)
+	{
+		return FilterGallop<false>(src1, num1, src2, num2, dst);
+	}
+	if (num2 * SUPERSET_GALLOP_RATIO <= num1)
+	{
+		return FilterGallop<false>(src2, num2, src1, num1, dst);
+	}
+	return Filter<false>(src1, num1, src2, num2, dst);
+}
+
+size_t SuperUnion(const T* src1, size_t num1, const T* src2, size_t num2, T* dst)
+{
+	if (num1 * SUPERSET_GALLOP_RATIO <= num2)
+	{
+		return CopyGallop<true>(src2, num2, src1, num1, dst);
+	}
+	if (num2 * SUPERSET_GALLOP_RATIO <= num1)
+	{
+		return CopyGallop<true>(src1, num1, src2, num2, dst);
+	}
+	return MergeUnique(src1, num1, src2, num2, dst);
+}
+
+size_t SuperDifference(const T* src1, size_t num1, const T* src2, size_t num2, T* dst)
+{
+	if (num1 * SUPERSET_GALLOP_RATIO <= num2)
+	{
+		return FilterGallop<true>(src1, num1, src2, num2, dst);
+	}
+	if (num2 * SUPERSET_GALLOP_RATIO <= num1)
+	{
+		return CopyGallop<false>(src1, num1, src2, num2, dst);
+	}
+	return Filter<true>(src1, num1, src2, num2, dst);
+}
@@ -0,0 +1,31 @@
+﻿/*
+	Copyright 2018 Toshihiro Shirakawa
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#pragma once
+// 重複の無い昇順の配列同士の集合演算
+// 結果はstd::set_intersection, std::set_union, std::set_differenceと同じで、戻り値は書き込んだ要素数
+// 片方がもう片方よりずっと短い場合は、短い方の要素ごとに長い方を指数探索で読み飛ばす
+
+#include <stddef.h>
+
+// 両方に含まれる要素をdstに書き込む。dstにはnum1要素分の領域が必要
+size_t SuperIntersect(const int* src1, size_t num1, const int* src2, size_t num2, int* dst);
+size_t SuperIntersect(const unsigned int* src1, size_t num1, const unsigned int* src2, size_t num2, unsigned int* dst);
+// どちらかに含まれる要素をdstに書き込む。dstにはnum1+num2要素分の領域が必要
+size_t SuperUnion(const int* src1, size_t num1, const int* src2, size_t num2, int* dst);
+size_t SuperUnion(const unsigned int* src1, size_t num1, const unsigned int* src2, size_t num2, unsigned int* dst);
+// src1に含まれsrc2に含まれない要素をdstに書き込む。dstにはnum1要素分の領域が必要
+size_t SuperDifference(const int* src1, size_t num1, const int* src2, size_t num2, int* dst);
+size_t SuperDifference(const unsigned int* src1, size_t num1, const unsigned int* src2, size_t num2, unsigned int* dst);
@@ -1,4 +1,4 @@
-/*
+﻿/*
 	Copyright 2018 Toshihiro Shirakawa
 
 	Licensed under the Apache License, Version 2.0 (the "License");
@@ -14,15 +14,382 @@
 	limitations under the License.
 */
 #include "SuperSort.h"
+#include <stdlib.h>
 #include <immintrin.h>
+#include <stdio.h>
+#include <atomic>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sched.h>
+#endif
+
+// この大きさ以上の作業領域は2MBのヒュージページで確保する
+#ifndef SUPERSORT_HUGEPAGE_THRESHOLD
+#define SUPERSORT_HUGEPAGE_THRESHOLD ((size_t)8 << 20)
+#endif
+
+// 作業領域の使用量。ワーカースレッドは起動したスレッドのものを共有するので各値はアトミックにする
+// 共有しているスレッドと未解放の領域が参照を持ち、全て無くなったら削除する
+struct SuperSortScratchCounter
+{
+	std::atomic<size_t> refs;
+	std::atomic<size_t> current;
+	std::atomic<size_t> peak;
+	std::atomic<size_t> allocations;
+};
+
+namespace {
+	const size_t ALIGNMENT = 256;
+	const size_t HUGEPAGE_SIZE = (size_t)2 << 20;
+
+	enum AllocKind
+	{
+		ALLOC_HEAP,
+		ALLOC_HUGEPAGE,
+		ALLOC_ARENA,
+	};
+
+	// 返すポインタの直前に置く管理情報
+	// アリーナは確保した時点のものに返すため、解放関数も覚えておく
+	// 別のスレッドで解放されても確保したスレッドの使用量から引けるよう、使用量の参照も持つ
+	struct AllocHeader
+	{
+		void* base;
+		size_t size;
+		AllocKind kind;
+		SuperSortArenaFree release;
+		void* user;
+		SuperSortScratchCounter* counter;
+	};
+
+	SuperSortScratchCounter* NewCounter()
+	{
+		SuperSortScratchCounter* counter = new SuperSortScratchCounter;
+		counter->refs = 1;
+		counter->current = 0;
+		counter->peak = 0;
+		counter->allocations = 0;
+		return counter;
+	}
+
+	void Retain(SuperSortScratchCounter* counter)
+	{
+		counter->refs++;
+	}
+
+	void Release(SuperSortScratchCounter* counter)
+	{
+		if (--counter->refs == 0)
+		{
+			delete counter;
+		}
+	}
+
+	// スレッド毎の作業領域の設定。counterは通常はスレッド自身のownで、
+	// SuperSortScratchScopeの間は引き継いだものに差し替わる
+	struct ThreadScratch
+	{
+		ThreadScratch()
+		{
+			alloc = NULL;
+			release = NULL;
+			user = NULL;
+			own = NewCounter();
+			counter = own;
+		}
+		~ThreadScratch()
+		{
+			Release(own);
+		}
+		SuperSortArenaAlloc alloc;
+		SuperSortArenaFree release;
+		void* user;
+		SuperSortScratchCounter* own;
+		SuperSortScratchCounter* counter;
+	};
+
+	thread_local ThreadScratch t_scratch;
+
+	void AddUsage(SuperSortScratchCounter* counter, size_t size)
+	{
+		size_t current = counter->current.fetch_add(size) + size;
+		size_t peak = counter->peak.load();
+		while (current > peak && !counter->peak.compare_exchange_weak(peak, current))
+		{
+		}
+		counter->allocations++;
+	}
+
+	// baseから確保した領域の中で、ALIGNMENT境界に揃えた位置を返し管理情報を書き込む
+	void* Attach(void* base, size_t size, AllocKind kind)
+	{
+		char* ptr = (char*)(((size_t)base + sizeof(AllocHeader) + ALIGNMENT - 1) & ~(ALIGNMENT - 1));
+		AllocHeader* header = (AllocHeader*)ptr - 1;
+		header->base = base;
+		header->size = size;
+		header->kind = kind;
+		header->release = t_scratch.release;
+		header->user = t_scratch.user;
+		header->counter = t_scratch.counter;
+		Retain(header->counter);
+		return ptr;
+	}
+
+	// ページフォルトがソート中に起きないよう、先に全ページに触れておく
+	void PreFault(void* base, size_t size)
+	{
+		volatile char* p = (volatile char*)base;
+		size_t i;
+		for (i = 0; i < size; i += 4096)
+		{
+			p[i] = 0;
+		}
+	}
+
+	// ヒュージページで確保する。確保できなければNULLを返す
+	void* HugePageAlloc(size_t size)
+	{
+#ifdef _WIN32
+		// ラージページはSeLockMemoryPrivilegeが必要。無ければ失敗する
+		size_t page = GetLargePageMinimum();
+		if (page == 0)
+		{
+			return NULL;
+		}
+		size = (size + page - 1) & ~(page - 1);
+		return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+#else
+		size = (size + HUGEPAGE_SIZE - 1) & ~(HUGEPAGE_SIZE - 1);
+#ifdef MAP_HUGETLB
+		// 予約済みのヒュージページを使う。MAP_POPULATEで確保時にフォルトを済ませる
+		void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+		if (ptr != MAP_FAILED)
+		{
+			return ptr;
+		}
+#endif
+		// 予約が無ければ透過的ヒュージページを使う。2MB境界に揃えるため余分に確保して前後を返す
+		char* raw = (char*)mmap(NULL, size + HUGEPAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (raw == MAP_FAILED)
+		{
+			return NULL;
+		}
+		char* aligned = (char*)(((size_t)raw + HUGEPAGE_SIZE - 1) & ~(HUGEPAGE_SIZE - 1));
+		if (aligned != raw)
+		{
+			munmap(raw, aligned - raw);
+		}
+		munmap(aligned + size, raw + HUGEPAGE_SIZE - aligned);
+#ifdef MADV_HUGEPAGE
+		madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+		PreFault(aligned, size);
+		return aligned;
+#endif
+	}
+
+	void HugePageFree(void* ptr, size_t size)
+	{
+#ifdef _WIN32
+		(void)size;
+		VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+		munmap(ptr, (size + HUGEPAGE_SIZE - 1) & ~(HUGEPAGE_SIZE - 1));
+#endif
+	}
+} // namespace
+
+void SetSuperSortArena(SuperSortArenaAlloc alloc, SuperSortArenaFree release, void* user)
+{
+	t_scratch.alloc = alloc;
+	t_scratch.release = release;
+	t_scratch.user = user;
+}
+
+SuperSortScratchStats GetSuperSortScratchStats()
+{
+	SuperSortScratchCounter* counter = t_scratch.counter;
+	SuperSortScratchStats stats;
+	stats.current = counter->current.load();
+	stats.peak = counter->peak.load();
+	stats.allocations = counter->allocations.load();
+	return stats;
+}
+
+void ResetSuperSortScratchPeak()
+{
+	SuperSortScratchCounter* counter = t_scratch.counter;
+	counter->peak.store(counter->current.load());
+}
+
+SuperSortScratchContext::SuperSortScratchContext()
+{
+	m_alloc = t_scratch.alloc;
+	m_release = t_scratch.release;
+	m_user = t_scratch.user;
+	m_counter = t_scratch.counter;
+	Retain(m_counter);
+}
+
+SuperSortScratchContext::SuperSortScratchContext(const SuperSortScratchContext& other)
+{
+	m_alloc = other.m_alloc;
+	m_release = other.m_release;
+	m_user = other.m_user;
+	m_counter = other.m_counter;
+	Retain(m_counter);
+}
+
+SuperSortScratchContext::~SuperSortScratchContext()
+{
+	Release(m_counter);
+}
+
+SuperSortScratchScope::SuperSortScratchScope(const SuperSortScratchContext& context)
+{
+	m_alloc = t_scratch.alloc;
+	m_release = t_scratch.release;
+	m_user = t_scratch.user;
+	m_counter = t_scratch.counter;
+	t_scratch.alloc = context.m_alloc;
+	t_scratch.release = context.m_release;
+	t_scratch.user = context.m_user;
+	t_scratch.counter = context.m_counter;
+}
+
+SuperSortScratchScope::~SuperSortScratchScope()
+{
+	t_scratch.alloc = m_alloc;
+	t_scratch.release = m_release;
+	t_scratch.user = m_user;
+	t_scratch.counter = m_counter;
+}
 
 void* AlignedMalloc(size_t size)
 {
-	void* ptr = _mm_malloc(size, 256);
-	return ptr;
+	// 管理情報とアライメント調整の分を余分に確保する
+	size_t total = size + sizeof(AllocHeader) + ALIGNMENT - 1;
+	void* base = NULL;
+	AllocKind kind = ALLOC_HEAP;
+	if (t_scratch.alloc)
+	{
+		base = t_scratch.alloc(total, t_scratch.user);
+		kind = ALLOC_ARENA;
+	}
+	if (!base && size >= SUPERSORT_HUGEPAGE_THRESHOLD)
+	{
+		base = HugePageAlloc(total);
+		kind = ALLOC_HUGEPAGE;
+	}
+	if (!base)
+	{
+		base = malloc(total);
+		kind = ALLOC_HEAP;
+	}
+	if (!base)
+	{
+		return NULL;
+	}
+	AddUsage(t_scratch.counter, size);
+	return Attach(base, total, kind);
 }
 
 void AlignedFree(void* ptr)
 {
-	_mm_free(ptr);
+	if (!ptr)
+	{
+		return;
+	}
+	AllocHeader* header = (AllocHeader*)ptr - 1;
+	header->counter->current -= header->size - (sizeof(AllocHeader) + ALIGNMENT - 1);
+	Release(header->counter);
+	if (header->kind == ALLOC_ARENA)
+	{
+		header->release(header->base, header->size, header->user);
+	}
+	else if (header->kind == ALLOC_HUGEPAGE)
+	{
+		HugePageFree(header->base, header->size);
+	}
+	else
+	{
+		free(header->base);
+	}
+}
+
+int SuperSortNumaNodes()
+{
+#ifdef _WIN32
+	ULONG highest;
+	if (!GetNumaHighestNodeNumber(&highest))
+	{
+		return 1;
+	}
+	return (int)highest + 1;
+#else
+	int nodes = 0;
+	char path[64];
+	while (1)
+	{
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", nodes);
+		FILE* fp = fopen(path, "r");
+		if (!fp)
+		{
+			break;
+		}
+		fclose(fp);
+		nodes++;
+	}
+	return nodes ? nodes : 1;
+#endif
+}
+
+bool SuperSortBindNode(int node)
+{
+#ifdef _WIN32
+	GROUP_AFFINITY affinity;
+	if (!GetNumaNodeProcessorMaskEx((USHORT)node, &affinity) || !affinity.Mask)
+	{
+		return false;
+	}
+	return SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL) != 0;
+#else
+	// cpulistは"0-3,8-11"のような形式
+	char path[64];
+	snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+	FILE* fp = fopen(path, "r");
+	if (!fp)
+	{
+		return false;
+	}
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	int first, last, count = 0;
+	while (fscanf(fp, "%d", &first) == 1)
+	{
+		last = first;
+		int c = fgetc(fp);
+		if (c == '-')
+		{
+			if (fscanf(fp, "%d", &last) != 1)
+			{
+				break;
+			}
+			c = fgetc(fp);
+		}
+		for (; first <= last && first < CPU_SETSIZE; first++)
+		{
+			CPU_SET(first, &set);
+			count++;
+		}
+		if (c != ',')
+		{
+			break;
+		}
+	}
+	fclose(fp);
+	return count && sched_setaffinity(0, sizeof(set), &set) == 0;
+#endif
 }
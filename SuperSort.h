@@ -1,4 +1,4 @@
-/*
+﻿/*
 	Copyright 2018 Toshihiro Shirakawa
 
 	Licensed under the Apache License, Version 2.0 (the "License");
@@ -14,8 +14,113 @@
 	limitations under the License.
 */
 #pragma once
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
 
+// 作業領域の確保と解放。大きな領域はヒュージページで確保する
 void* AlignedMalloc(size_t size);
 void AlignedFree(void* ptr);
+
+// 作業領域を独自のアリーナから確保する。allocがNULLを返した場合は既定の確保に戻る
+// releaseにはallocに渡したのと同じ大きさが渡される。確保済みの領域は確保時のreleaseで解放される
+// アリーナは呼び出したスレッドにだけ設定され、そのスレッドから呼んだソートが起動するワーカースレッドに引き継がれる
+// 並列版ではalloc、releaseが複数のスレッドから同時に呼ばれ、releaseは確保したのと別のスレッドから呼ばれることもある
+typedef void* (*SuperSortArenaAlloc)(size_t size, void* user);
+typedef void (*SuperSortArenaFree)(void* ptr, size_t size, void* user);
+void SetSuperSortArena(SuperSortArenaAlloc alloc, SuperSortArenaFree release, void* user);
+
+// 作業領域の使用量(AlignedMallocに要求されたバイト数)
+// アリーナと同じくスレッド毎に数え、ワーカースレッドの使用量は起動したスレッドの分に含める
+struct SuperSortScratchStats
+{
+	size_t current;
+	size_t peak;
+	size_t allocations;
+};
+SuperSortScratchStats GetSuperSortScratchStats();
+// ピーク値を現在の使用量に戻す
+void ResetSuperSortScratchPeak();
+
+// 作業領域のアリーナと統計をワーカースレッドに引き継ぐための記録
+// 生成したスレッドの設定を取り込み、ワーカースレッドの中でSuperSortScratchScopeに渡す
+struct SuperSortScratchCounter;
+class SuperSortScratchContext
+{
+public:
+	SuperSortScratchContext();
+	SuperSortScratchContext(const SuperSortScratchContext& other);
+	SuperSortScratchContext& operator=(const SuperSortScratchContext&) = delete;
+	~SuperSortScratchContext();
+
+private:
+	friend class SuperSortScratchScope;
+	SuperSortArenaAlloc m_alloc;
+	SuperSortArenaFree m_release;
+	void* m_user;
+	SuperSortScratchCounter* m_counter;
+};
+
+// 生存期間の間、現在のスレッドでcontextのアリーナと統計を使う。終わると元に戻す
+class SuperSortScratchScope
+{
+public:
+	explicit SuperSortScratchScope(const SuperSortScratchContext& context);
+	~SuperSortScratchScope();
+	SuperSortScratchScope(const SuperSortScratchScope&) = delete;
+	SuperSortScratchScope& operator=(const SuperSortScratchScope&) = delete;
+
+private:
+	SuperSortArenaAlloc m_alloc;
+	SuperSortArenaFree m_release;
+	void* m_user;
+	SuperSortScratchCounter* m_counter;
+};
+
+// NUMAノード数。取得できなければ1を返す
+int SuperSortNumaNodes();
+// 呼び出したスレッドをノードnodeのCPUに割り当てる
+bool SuperSortBindNode(int node);
+
+// 複数スレッドでソートする。threadsが0ならハードウェアスレッド数を使う
+// numaならスレッドをNUMAノードに割り当て、作業領域を各スレッドのノードに確保する
+// cancelが立つと最後のマージの前に中断してfalseを返す。その場合配列は元のまま
+// 要素数の約3倍のワーキングメモリを必要とする
+bool SuperSortParallel(int* array, size_t num, int threads = 0, bool numa = false, const std::atomic<bool>* cancel = NULL);
+bool SuperSortParallel(unsigned int* array, size_t num, int threads = 0, bool numa = false, const std::atomic<bool>* cancel = NULL);
+// 各スレッドの部分ソートにSuperQuickSortを使う版
+bool SuperQuickSortParallel(int* array, size_t num, int threads = 0, bool numa = false, const std::atomic<bool>* cancel = NULL);
+bool SuperQuickSortParallel(unsigned int* array, size_t num, int threads = 0, bool numa = false, const std::atomic<bool>* cancel = NULL);
+
+// 別々の領域にあるソート済みのcount本の列をマージし、先頭num要素をdstに書き込む
+// 各列は32バイト境界から始まり、長さはlens[i] * 32要素
+void SuperMergeRuns(int* const* runs, const size_t* lens, size_t count, int* dst, size_t num);
+void SuperMergeRuns(unsigned int* const* runs, const size_t* lens, size_t count, unsigned int* dst, size_t num);
+
+// ソート済みの2つの列をdstにマージする。threadsが0ならハードウェアスレッド数を使う
+// 入力の位置と長さは任意。dstは入力と重なってはいけない
+void SuperMerge(const int* src1, size_t num1, const int* src2, size_t num2, int* dst, int threads = 0);
+void SuperMerge(const unsigned int* src1, size_t num1, const unsigned int* src2, size_t num2, unsigned int* dst, int threads = 0);
+
 void SuperSort(int* array, size_t num);
 void SuperSort(unsigned int* array, size_t num);
+void SuperSortDesc(int* array, size_t num);
+void SuperSortDesc(unsigned int* array, size_t num);
+// 絶対値の昇順にソートする。絶対値が等しい場合は負の値が先になる
+void SuperSortAbs(int* array, size_t num);
+// 符号ビットを反転したビット列の順にソートする。-NaN < -inf < ... < -0.0 < +0.0 < ... < +inf < +NaN
+void SuperSortF(float* array, size_t num);
+// 注意: SuperSortDはNaNを含まない入力専用。NaNがあると値が失われ、並びも崩れる
+// また-0.0と+0.0を区別しないため、ゼロの符号が入れ替わることがある。ビット列を保つ必要があればSuperSortDTotalを使う
+void SuperSortD(double* array, size_t num);
+// 全順序でソートする。-inf < ... < -0.0 < +0.0 < ... < +inf < +NaN < -NaN
+// NaNは符号に関わらず末尾に集まる。NaNの符号とペイロードは保たれ、結果は入力のビット列の並べ替えになる
+void SuperSortDTotal(double* array, size_t num);
+size_t SuperTopKFilter(int* dst, const int* src, size_t num, int threshold);
+size_t SuperTopKFilter(unsigned int* dst, const unsigned int* src, size_t num, unsigned int threshold);
+void SuperTopKMerge(int* top, size_t topsize, int* buf, size_t bufsize, int* work);
+void SuperTopKMerge(unsigned int* top, size_t topsize, unsigned int* buf, size_t bufsize, unsigned int* work);
+// ソートして重複を除き、残った要素数を返す。結果はarrayの先頭に詰められる
+// countsを渡すと各キーの出現回数を書き込む。countsには戻り値の要素数分(最大num要素)の領域が必要
+size_t SuperSortUnique(int* array, size_t num, size_t* counts = NULL);
+size_t SuperSortUnique(unsigned int* array, size_t num, size_t* counts = NULL);
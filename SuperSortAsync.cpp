@@ -0,0 +1,174 @@
+﻿/*
+	Copyright 2018 Toshihiro Shirakawa
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "SuperSort.h"
+#include "SuperSortAsync.h"
+
+// 内部のスレッドプールのスレッド数
+// 各ソートは並列版で動くので、同時に進めるソートの数だけあればよい
+#ifndef SUPERSORTASYNC_WORKERS
+#define SUPERSORTASYNC_WORKERS 2
+#endif
+
+namespace {
+	// 最初に投入された時に作り、プログラム終了時に残りのタスクを実行してから止める
+	class TaskPool
+	{
+	public:
+		TaskPool(int workers)
+		{
+			int i;
+			for (i = 0; i < workers; i++)
+			{
+				m_workers.emplace_back([this]() { Run(); });
+			}
+		}
+		~TaskPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stop = true;
+			}
+			m_cond.notify_all();
+			for (auto& th : m_workers)
+			{
+				th.join();
+			}
+		}
+		void Submit(std::function<void()> task)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_tasks.push_back(std::move(task));
+			}
+			m_cond.notify_one();
+		}
+
+	private:
+		void Run()
+		{
+			while (1)
+			{
+				std::function<void()> task;
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_cond.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+					if (m_tasks.empty())
+					{
+						return;
+					}
+					task = std::move(m_tasks.front());
+					m_tasks.pop_front();
+				}
+				task();
+			}
+		}
+
+		std::mutex m_mutex;
+		std::condition_variable m_cond;
+		std::deque<std::function<void()>> m_tasks;
+		std::vector<std::thread> m_workers;
+		bool m_stop = false;
+	};
+
+	TaskPool& DefaultPool()
+	{
+		static TaskPool pool(SUPERSORTASYNC_WORKERS);
+		return pool;
+	}
+
+	template<typename T>
+	void Submit(T* array, size_t num, bool quick, SuperSortCallback callback, SuperSortCancelToken cancel, const SuperSortExecutor& executor, int threads)
+	{
+		// タスクは投入したスレッドのアリーナと統計を使う
+		SuperSortScratchContext scratch;
+		auto task = [=]() {
+			SuperSortScratchScope scope(scratch);
+			SuperSortStatus status = SuperSortStatus::Cancelled;
+			if (!cancel.IsCancelled())
+			{
+				bool completed = quick ? SuperQuickSortParallel(array, num, threads, false, cancel.Flag()) : SuperSortParallel(array, num, threads, false, cancel.Flag());
+				status = completed ? SuperSortStatus::Completed : SuperSortStatus::Cancelled;
+			}
+			if (callback)
+			{
+				callback(status);
+			}
+		};
+		if (executor)
+		{
+			executor(task);
+		}
+		else
+		{
+			DefaultPool().Submit(task);
+		}
+	}
+
+	template<typename T>
+	std::future<SuperSortStatus> Submit(T* array, size_t num, bool quick, SuperSortCancelToken cancel, const SuperSortExecutor& executor, int threads)
+	{
+		auto promise = std::make_shared<std::promise<SuperSortStatus>>();
+		std::future<SuperSortStatus> future = promise->get_future();
+		Submit(array, num, quick, [promise](SuperSortStatus status) { promise->set_value(status); }, cancel, executor, threads);
+		return future;
+	}
+} // namespace
+
+std::future<SuperSortStatus> SuperSortAsync(int* array, size_t num, SuperSortCancelToken cancel, const SuperSortExecutor& executor, int threads)
+{
+	return Submit(array, num, false, cancel, executor, threads);
+}
+
+std::future<SuperSortStatus> SuperSortAsync(unsigned int* array, size_t num, SuperSortCancelToken cancel, const SuperSortExecutor& executor, int threads)
+{
+	return Submit(array, num, false, cancel, executor, threads);
+}
+
+std::future<SuperSortStatus> SuperQuickSortAsync(int* array, size_t num, SuperSortCancelToken cancel, const SuperSortExecutor& executor, int threads)
+{
+	return Submit(array, num, true, cancel, executor, threads);
+}
+
+std::future<SuperSortStatus> SuperQuickSortAsync(unsigned int* array, size_t num, SuperSortCancelToken cancel, const SuperSortExecutor& executor, int threads)
+{
+	return Submit(array, num, true, cancel, executor, threads);
+}
+
+void SuperSortAsync(int* array, size_t num, SuperSortCallback callback, SuperSortCancelToken cancel, const SuperSortExecutor& executor, int threads)
+{
+	Submit(array, num, false, callback, cancel, executor, threads);
+}
+
+void SuperSortAsync(unsigned int* array, size_t num, SuperSortCallback callback, SuperSortCancelToken cancel, const SuperSortExecutor& executor, int threads)
+{
+	Submit(array, num, false, callback, cancel, executor, threads);
+}
+
+void SuperQuickSortAsync(int* array, size_t num, SuperSortCallback callback, SuperSortCancelToken cancel, const SuperSortExecutor& executor, int threads)
+{
+	Submit(array, num, true, callback, cancel, executor, threads);
+}
+
+void SuperQuickSortAsync(unsigned int* array, size_t num, SuperSortCallback callback, SuperSortCancelToken cancel, const SuperSortExecutor& executor, int threads)
+{
+	Submit(array, num, true, callback, cancel, executor, threads);
+}
@@ -0,0 +1,74 @@
+﻿/*
+	Copyright 2018 Toshihiro Shirakawa
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#pragma once
+// ソートをスレッドプールに投入し、呼び出し元を待たせずに結果をfutureかコールバックで返す
+// ソートにはSuperSortParallel、SuperQuickSortParallelを使う
+
+#include <stddef.h>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+
+enum class SuperSortStatus
+{
+	Completed,
+	Cancelled,
+};
+
+// ソートの取り消し。コピーしたトークンは同じ取り消し状態を共有する
+// 開始前に取り消したソートは実行されず、実行中のソートは最後のマージの前に中断される
+// 中断された場合、配列は元のまま
+class SuperSortCancelToken
+{
+public:
+	SuperSortCancelToken()
+		: m_flag(std::make_shared<std::atomic<bool>>(false))
+	{
+	}
+	void Cancel()
+	{
+		m_flag->store(true);
+	}
+	bool IsCancelled() const
+	{
+		return m_flag->load();
+	}
+	const std::atomic<bool>* Flag() const
+	{
+		return m_flag.get();
+	}
+
+private:
+	std::shared_ptr<std::atomic<bool>> m_flag;
+};
+
+// タスクを実行する関数。空なら内部のスレッドプールを使う
+typedef std::function<void(std::function<void()>)> SuperSortExecutor;
+typedef std::function<void(SuperSortStatus)> SuperSortCallback;
+
+// threadsは1つのソートが使うスレッド数。0ならハードウェアスレッド数を使う
+// 完了するまで配列に触れないこと
+std::future<SuperSortStatus> SuperSortAsync(int* array, size_t num, SuperSortCancelToken cancel = SuperSortCancelToken(), const SuperSortExecutor& executor = nullptr, int threads = 0);
+std::future<SuperSortStatus> SuperSortAsync(unsigned int* array, size_t num, SuperSortCancelToken cancel = SuperSortCancelToken(), const SuperSortExecutor& executor = nullptr, int threads = 0);
+std::future<SuperSortStatus> SuperQuickSortAsync(int* array, size_t num, SuperSortCancelToken cancel = SuperSortCancelToken(), const SuperSortExecutor& executor = nullptr, int threads = 0);
+std::future<SuperSortStatus> SuperQuickSortAsync(unsigned int* array, size_t num, SuperSortCancelToken cancel = SuperSortCancelToken(), const SuperSortExecutor& executor = nullptr, int threads = 0);
+
+// 完了時にcallbackをソートを実行したスレッドから呼ぶ
+void SuperSortAsync(int* array, size_t num, SuperSortCallback callback, SuperSortCancelToken cancel = SuperSortCancelToken(), const SuperSortExecutor& executor = nullptr, int threads = 0);
+void SuperSortAsync(unsigned int* array, size_t num, SuperSortCallback callback, SuperSortCancelToken cancel = SuperSortCancelToken(), const SuperSortExecutor& executor = nullptr, int threads = 0);
+void SuperQuickSortAsync(int* array, size_t num, SuperSortCallback callback, SuperSortCancelToken cancel = SuperSortCancelToken(), const SuperSortExecutor& executor = nullptr, int threads = 0);
+void SuperQuickSortAsync(unsigned int* array, size_t num, SuperSortCallback callback, SuperSortCancelToken cancel = SuperSortCancelToken(), const SuperSortExecutor& executor = nullptr, int threads = 0);
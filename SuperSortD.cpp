@@ -2,35 +2,42 @@
 #include <memory>
 #include <immintrin.h>
 
+#include "SuperSort.h"
+#define SUPERSORTNETWORK_SCHEDULE_ONLY
+#include "SuperSortNetwork.h"
+
+#ifdef SUPERSORTD_TOTALORDER
+// 全順序モード。doubleのビット列を符号反転でint64のキーに変換してソートする
+// -inf < ... < -0.0 < +0.0 < ... < +inf < +NaN < -NaNの順になり、NaNは符号に関わらず末尾に集まる
+// 変換は全単射なので、NaNの符号やペイロードも含めて入力のビット列がそのまま並べ替えられる
+#define SuperSortD SuperSortDTotal
+#endif
+
 // ソート本体
 void SuperSortD(double* array, size_t num);
 
 
 namespace {
-	size_t g_bufsize = 0;
-	double* g_buf1;
-	double* g_buf2;
-	void* AlignedMalloc(size_t size)
-	{
-		void* ptr = _mm_malloc(size, 32);
-		return ptr;
-	}
-
-	void AlignedFree(void* ptr)
-	{
-		_mm_free(ptr);
-	}
-	void SuperSortDAligned(double* array, size_t num);
+	void SuperSortDAligned(double* array, size_t num, double* buf);
 	void SuperSortD32(double* arr, double* dst = NULL);
 	void SuperSortD48(double* arr, double* dst = NULL);
 	void SuperSortD64(double* arr, double* dst = NULL);
+#ifdef SUPERSORTD_TOTALORDER
+	template<bool Decode>
+	void TransformKeys(double* dst, const double* src, size_t num);
+	double KeyMax();
+#endif
 } // namespace
 
+#ifdef SUPERSORTD_TOTALORDER
+#define PADDING_MAX KeyMax()
+#else
 #define PADDING_MAX INFINITY
+#endif
 
 void SuperSortD(double* arr, size_t num)
 {
-	bool isAligned = (((size_t)arr) & 16) == 0;
+	bool isAligned = (((size_t)arr) & 31) == 0;
 	size_t alignedsize;
 	if (num < 32)
 	{
@@ -38,24 +45,21 @@ void SuperSortD(double* arr, size_t num)
 	}
 	else
 	{
-		alignedsize = (num - 1 | 15) + 1;
-	}
-	if (alignedsize > g_bufsize)
-	{
-		if (g_bufsize)
-		{
-			AlignedFree(g_buf1);
-			AlignedFree(g_buf2);
-		}
-		g_bufsize = alignedsize * 2;
-		g_buf1 = (double*)AlignedMalloc(sizeof(double) * g_bufsize);
-		g_buf2 = (double*)AlignedMalloc(sizeof(double) * g_bufsize);
+		alignedsize = ((num - 1) | 15) + 1;
 	}
-	if (num == alignedsize && isAligned)
+	// 作業領域は呼び出し毎に確保して解放する。アリーナや使用量の統計が呼び出しの範囲で閉じるようにする
+	// buf1はパディングしたコピー、buf2はマージの相手。どちらも必要な場合だけ要素数分を確保する
+	bool copy = !(num == alignedsize && isAligned);
+	double* buf1 = copy ? (double*)AlignedMalloc(sizeof(double) * alignedsize) : NULL;
+	double* buf2 = alignedsize > 64 ? (double*)AlignedMalloc(sizeof(double) * alignedsize) : NULL;
+	if (!copy)
 	{
+#ifdef SUPERSORTD_TOTALORDER
+		TransformKeys<false>(arr, arr, num);
+#endif
 		if (alignedsize > 64)
 		{
-			SuperSortDAligned(arr, alignedsize / 16);
+			SuperSortDAligned(arr, alignedsize / 16, buf2);
 		}
 		else if (alignedsize == 32)
 		{
@@ -69,19 +73,26 @@ void SuperSortD(double* arr, size_t num)
 		{
 			SuperSortD64(arr);
 		}
+#ifdef SUPERSORTD_TOTALORDER
+		TransformKeys<true>(arr, arr, num);
+#endif
 	}
 	else
 	{
-		double* buf = g_buf1;
+		double* buf = buf1;
 		size_t i;
 		for (i = num; i < alignedsize; i++)
 		{
 			buf[i] = PADDING_MAX;
 		}
+#ifdef SUPERSORTD_TOTALORDER
+		TransformKeys<false>(buf, arr, num);
+#else
 		memcpy(buf, arr, sizeof(double) * num);
+#endif
 		if (alignedsize > 64)
 		{
-			SuperSortDAligned(buf, alignedsize / 16);
+			SuperSortDAligned(buf, alignedsize / 16, buf2);
 		}
 		else if (alignedsize == 32)
 		{
@@ -95,12 +106,93 @@ void SuperSortD(double* arr, size_t num)
 		{
 			SuperSortD64(buf);
 		}
+#ifdef SUPERSORTD_TOTALORDER
+		TransformKeys<true>(arr, buf, num);
+#else
 		memcpy(arr, buf, sizeof(double) * num);
+#endif
 	}
+	AlignedFree(buf1);
+	AlignedFree(buf2);
 }
 
 namespace {
 
+#ifdef SUPERSORTD_TOTALORDER
+	// 比較器。キーをint64として比較する
+	auto Comparator = [](__m256d & lo, __m256d & hi) {
+		__m256d gt, t;
+		gt = _mm256_castsi256_pd(_mm256_cmpgt_epi64(_mm256_castpd_si256(lo), _mm256_castpd_si256(hi)));
+		t = _mm256_blendv_pd(lo, hi, gt);
+		hi = _mm256_blendv_pd(hi, lo, gt);
+		lo = t;
+	};
+
+	bool Greater(double a, double b)
+	{
+		long long x, y;
+		memcpy(&x, &a, sizeof(x));
+		memcpy(&y, &b, sizeof(y));
+		return x > y;
+	}
+
+	// 符号ビットの立った値を反転した時に最小側に来る-NaNの個数
+	const long long NEGATIVE_NANS = 0x000FFFFFFFFFFFFFLL;
+
+	// doubleのビット列をint64として比較できるキーに変換する。Decodeなら逆変換
+	// 符号ビットが立っている場合は残りのビットを反転し、さらに-NaNの個数だけ引いて
+	// 最小側に来る-NaNを桁あふれで+NaNの後ろに回す
+	template<bool Decode>
+	void TransformKeys(double* dst, const double* src, size_t num)
+	{
+		__m256i low = _mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFLL);
+		__m256i nans = _mm256_set1_epi64x(NEGATIVE_NANS);
+		size_t i;
+		for (i = 0; i + 4 <= num; i += 4)
+		{
+			__m256i b = _mm256_castpd_si256(_mm256_loadu_pd(src + i));
+			if constexpr (Decode)
+			{
+				b = _mm256_add_epi64(b, nans);
+			}
+			__m256i sign = _mm256_cmpgt_epi64(_mm256_setzero_si256(), b);
+			b = _mm256_xor_si256(b, _mm256_and_si256(sign, low));
+			if constexpr (!Decode)
+			{
+				b = _mm256_sub_epi64(b, nans);
+			}
+			_mm256_storeu_pd(dst + i, _mm256_castsi256_pd(b));
+		}
+		for (; i < num; i++)
+		{
+			unsigned long long b;
+			memcpy(&b, src + i, sizeof(b));
+			if constexpr (Decode)
+			{
+				b += NEGATIVE_NANS;
+			}
+			if ((long long)b < 0)
+			{
+				b ^= 0x7FFFFFFFFFFFFFFFULL;
+			}
+			if constexpr (!Decode)
+			{
+				b -= NEGATIVE_NANS;
+			}
+			memcpy(dst + i, &b, sizeof(b));
+		}
+	}
+
+	// キーの最大値。パディングに使う
+	// 最大の-NaNと同じキーになるが、同じビット列の要素はパディングと入れ替わっても結果が変わらない
+	double KeyMax()
+	{
+		long long b = 0x7FFFFFFFFFFFFFFFLL;
+		double d;
+		memcpy(&d, &b, sizeof(d));
+		return d;
+	}
+#else
 	// 比較器
 	auto Comparator = [](__m256d & lo, __m256d & hi) {
 		__m256d t;
@@ -108,6 +200,12 @@ namespace {
 		hi = _mm256_max_pd(lo, hi);
 		lo = t;
 	};
+
+	bool Greater(double a, double b)
+	{
+		return a > b;
+	}
+#endif
 	auto Swap01 = [](__m256d & lo, __m256d & hi) {
 		__m256d t;
 		t = _mm256_shuffle_pd(lo, hi, 0);
@@ -126,18 +224,8 @@ namespace {
 	m5 = _mm256_permute4x64_pd(m5, 0x1B);\
 	m6 = _mm256_permute4x64_pd(m6, 0x1B);\
 	m7 = _mm256_permute4x64_pd(m7, 0x1B);\
-	Comparator(m0, m7);\
-	Comparator(m1, m6);\
-	Comparator(m2, m5);\
-	Comparator(m3, m4);\
-	Comparator(m0, m2);\
-	Comparator(m1, m3);\
-	Comparator(m4, m6);\
-	Comparator(m5, m7);\
-	Comparator(m0, m1);\
-	Comparator(m2, m3);\
-	Comparator(m4, m5);\
-	Comparator(m6, m7);\
+	ApplyNetwork<FlipNetwork<8>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);\
+	ApplyNetwork<HalfCleanerNetwork<8, 2>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);\
 	Swap02(m0, m2);\
 	Swap02(m1, m3);\
 	Swap02(m4, m6);\
@@ -146,14 +234,7 @@ namespace {
 	Swap01(m2, m3);\
 	Swap01(m4, m5);\
 	Swap01(m6, m7);\
-	Comparator(m0, m2);\
-	Comparator(m1, m3);\
-	Comparator(m4, m6);\
-	Comparator(m5, m7);\
-	Comparator(m0, m1);\
-	Comparator(m2, m3);\
-	Comparator(m4, m5);\
-	Comparator(m6, m7);\
+	ApplyNetwork<HalfCleanerNetwork<8, 2>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);\
 	Swap02(m0, m2);\
 	Swap02(m1, m3);\
 	Swap02(m4, m6);\
@@ -181,35 +262,14 @@ namespace {
 		m6 = _mm256_load_pd((arr + 24));
 		m7 = _mm256_load_pd((arr + 28));
 		// 4並列でバッチャー奇偶マージソートを実行
-		Comparator(m0, m1);
-		Comparator(m2, m3);
-		Comparator(m4, m5);
-		Comparator(m6, m7);
-		Comparator(m0, m2);
-		Comparator(m1, m3);
-		Comparator(m4, m6);
-		Comparator(m5, m7);
-		Comparator(m1, m2);
-		Comparator(m5, m6);
-		Comparator(m0, m4);
-		Comparator(m1, m5);
-		Comparator(m2, m6);
-		Comparator(m3, m7);
-		Comparator(m2, m4);
-		Comparator(m3, m5);
-		Comparator(m1, m2);
-		Comparator(m3, m4);
-		Comparator(m5, m6);
+		ApplyNetwork<OddEvenMergeSortNetwork<8>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);
 		// 0と1、2と3をスワップ
 		m4 = _mm256_permute4x64_pd(m4, 0xB1);
 		m5 = _mm256_permute4x64_pd(m5, 0xB1);
 		m6 = _mm256_permute4x64_pd(m6, 0xB1);
 		m7 = _mm256_permute4x64_pd(m7, 0xB1);
 
-		Comparator(m0, m7);
-		Comparator(m1, m6);
-		Comparator(m2, m5);
-		Comparator(m3, m4);
+		ApplyNetwork<FlipNetwork<8>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);
 		// m0の0とm7の1、m0の2とm7の3、・・・をスワップ
 		Swap01(m0, m7);
 		Swap01(m1, m6);
@@ -218,28 +278,14 @@ namespace {
 
 		// バイトニック列をソート
 		auto SortBitnic = [&]() {
-			Comparator(m0, m4);
-			Comparator(m1, m5);
-			Comparator(m2, m6);
-			Comparator(m3, m7);
-			Comparator(m0, m2);
-			Comparator(m1, m3);
-			Comparator(m4, m6);
-			Comparator(m5, m7);
-			Comparator(m0, m1);
-			Comparator(m2, m3);
-			Comparator(m4, m5);
-			Comparator(m6, m7);
+			ApplyNetwork<HalfCleanerNetwork<8>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);
 		};
 		SortBitnic();
 		m4 = _mm256_permute4x64_pd(m4, 0x1B);
 		m5 = _mm256_permute4x64_pd(m5, 0x1B);
 		m6 = _mm256_permute4x64_pd(m6, 0x1B);
 		m7 = _mm256_permute4x64_pd(m7, 0x1B);
-		Comparator(m0, m7);
-		Comparator(m1, m6);
-		Comparator(m2, m5);
-		Comparator(m3, m4);
+		ApplyNetwork<FlipNetwork<8>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);
 		Swap01(m0, m4);
 		Swap01(m1, m5);
 		Swap01(m2, m6);
@@ -383,7 +429,7 @@ namespace {
 		dst += 16;
 		while (1)
 		{
-			if (src1[0] > src2[0])
+			if (Greater(src1[0], src2[0]))
 			{
 				m0 = _mm256_load_pd(src2 + 0);
 				m1 = _mm256_load_pd(src2 + 4);
@@ -482,9 +528,8 @@ namespace {
 		}
 	}
 
-	void SuperSortDAligned(double * array, size_t num)
+	void SuperSortDAligned(double * array, size_t num, double* buf)
 	{
-		double* buf = g_buf2;
 		SuperSortRecD(buf, array, array, num);
 	}
 }// namespace
@@ -0,0 +1,111 @@
+﻿/*
+	Copyright 2018 Toshihiro Shirakawa
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#pragma once
+// std::sortの置き換えとして使える型汎用のインターフェース (C++20)
+// 要素型と要素数に応じて最適なソートを静的に選び、対応していない型はstd::sortで処理する
+
+#include <stddef.h>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <type_traits>
+
+#include "SuperSort.h"
+#include "SuperQuickSort.h"
+#include "SuperRadixSort.h"
+
+namespace supersort {
+	namespace detail {
+		template<typename T>
+		constexpr bool IsSuperSortable = std::is_same_v<T, int> || std::is_same_v<T, unsigned int> || std::is_same_v<T, double>;
+
+		template<typename Compare>
+		constexpr bool IsDefaultLess = std::is_same_v<Compare, std::less<>> || std::is_same_v<Compare, std::ranges::less>;
+
+		template<typename Compare>
+		constexpr bool IsDefaultGreater = std::is_same_v<Compare, std::greater<>> || std::is_same_v<Compare, std::ranges::greater>;
+
+		template<typename T>
+		void Sort(T* array, size_t num)
+		{
+			if constexpr (std::is_same_v<T, double>)
+			{
+				// SuperSortDはNaNや-0.0を保たないので、入力のビット列をそのまま並べ替える全順序版を使う
+				SuperSortDTotal(array, num);
+			}
+			else if constexpr (IsSuperSortable<T>)
+			{
+				// 要素数と分布に応じてSuperQuickSort、SuperSort、SuperRadixSortを選ぶ
+				SuperSortAuto(array, num);
+			}
+			else
+			{
+				std::sort(array, array + num);
+			}
+		}
+	} // namespace detail
+
+	// 連続領域をソートする
+	template<typename T>
+	void sort(std::span<T> s)
+	{
+		detail::Sort(s.data(), s.size());
+	}
+
+	// イテレータ範囲をソートする。連続イテレータでない場合はstd::sortで処理する
+	template<std::random_access_iterator It>
+	void sort(It first, It last)
+	{
+		using T = std::iter_value_t<It>;
+		if constexpr (std::contiguous_iterator<It> && detail::IsSuperSortable<T>)
+		{
+			detail::Sort(std::to_address(first), (size_t)(last - first));
+		}
+		else
+		{
+			std::sort(first, last);
+		}
+	}
+
+	// 比較関数付きのソート。std::less<T>、std::greater<T>以外の比較はstd::sortで処理する
+	template<std::random_access_iterator It, typename Compare>
+	void sort(It first, It last, Compare comp)
+	{
+		using T = std::iter_value_t<It>;
+		if constexpr (std::is_same_v<Compare, std::less<T>> || detail::IsDefaultLess<Compare>)
+		{
+			supersort::sort(first, last);
+		}
+		else if constexpr (std::contiguous_iterator<It> && (std::is_same_v<T, int> || std::is_same_v<T, unsigned int>) &&
+			(std::is_same_v<Compare, std::greater<T>> || detail::IsDefaultGreater<Compare>))
+		{
+			SuperSortDesc(std::to_address(first), (size_t)(last - first));
+		}
+		else
+		{
+			std::sort(first, last, comp);
+		}
+	}
+
+	// コンテナや配列をまとめてソートする。連続領域でない場合はstd::sortで処理する
+	template<std::ranges::random_access_range R>
+	void sort(R&& r)
+	{
+		supersort::sort(std::ranges::begin(r), std::ranges::end(r));
+	}
+} // namespace supersort
@@ -0,0 +1,355 @@
+﻿/*
+	Copyright 2018 Toshihiro Shirakawa
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#pragma once
+// ソーティングネットワークをコンパイル時に生成する
+// 前半はレジスタ間の比較器の並びで、要素型やレジスタ幅に依存しない。比較器(lo, hiを受け取って整列させる関数)を渡して適用する
+// 後半は32ビット要素8レーンのレジスタ内の比較(シャッフルとブレンド)も含めたバイトニックソートで、
+// 要素型T、PADDING_MAX、_mm256_min_epi32/_mm256_max_epi32の置き換えを定義した後にインクルードすること
+// 比較器の並びだけを使う場合はSUPERSORTNETWORK_SCHEDULE_ONLYを定義してからインクルードする
+
+#include <stddef.h>
+#include <immintrin.h>
+#include <tuple>
+#include <utility>
+
+// 比較器の並びはレジスタ渡しのまま展開されないと意味がないため、強制的にインライン化する
+#ifdef _MSC_VER
+#define SUPERSORT_FORCEINLINE __forceinline
+#else
+#define SUPERSORT_FORCEINLINE inline __attribute__((always_inline))
+#endif
+
+namespace {
+	// 比較するレジスタ番号の組
+	struct ComparatorPair
+	{
+		int lo;
+		int hi;
+	};
+
+	// N個の比較器の並び
+	template<size_t N>
+	struct ComparatorSchedule
+	{
+		ComparatorPair pair[N];
+	};
+
+	// n本のレジスタに対するバッチャー奇偶マージソートの比較器を順に列挙する
+	template<typename F>
+	constexpr void EnumOddEvenMergeSort(int n, F f)
+	{
+		for (int p = 1; p < n; p <<= 1)
+		{
+			for (int k = p; k >= 1; k >>= 1)
+			{
+				for (int j = k % p; j + k < n; j += k * 2)
+				{
+					for (int i = 0; i < k && i + j + k < n; i++)
+					{
+						if ((i + j) / (p * 2) == (i + j + k) / (p * 2))
+						{
+							f(i + j, i + j + k);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// n本のレジスタを長さ2kのバイトニック列とみなし、距離k以下のハーフクリーナーを列挙する
+	template<typename F>
+	constexpr void EnumHalfCleaner(int n, int k, F f)
+	{
+		for (; k >= 1; k >>= 1)
+		{
+			for (int i = 0; i < n; i++)
+			{
+				if ((i & k) == 0)
+				{
+					f(i, i + k);
+				}
+			}
+		}
+	}
+
+	// 前半と後半をそれぞれ逆順に突き合わせる比較器を列挙する
+	template<typename F>
+	constexpr void EnumFlip(int n, F f)
+	{
+		for (int i = 0; i < n / 2; i++)
+		{
+			f(i, n - 1 - i);
+		}
+	}
+
+	// n本のレジスタの列を、距離jレジスタ、ブロック長kレジスタのバイトニックソートの1段で比較する
+	// ブロック番号が奇数のブロックは降順にするので、大きい方をloに置く
+	// n本ずつ独立したgroups組の列を並べた場合は、組をまたいで同じ位置の比較器を続けて並べ、依存の待ちを重ねる
+	template<typename F>
+	constexpr void EnumBitonicStage(int n, int j, int k, int groups, F f)
+	{
+		for (int i = 0; i < n; i++)
+		{
+			if ((i & j) == 0)
+			{
+				for (int g = 0; g < groups; g++)
+				{
+					if (i & k)
+					{
+						f(g * n + i + j, g * n + i);
+					}
+					else
+					{
+						f(g * n + i, g * n + i + j);
+					}
+				}
+			}
+		}
+	}
+
+	// 列挙関数から比較器の並びを作る
+	template<size_t N, typename E>
+	constexpr ComparatorSchedule<N> MakeSchedule(E e)
+	{
+		ComparatorSchedule<N> s{};
+		size_t i = 0;
+		e([&](int lo, int hi) {
+			s.pair[i].lo = lo;
+			s.pair[i].hi = hi;
+			i++;
+		});
+		return s;
+	}
+
+	template<typename E>
+	constexpr size_t CountSchedule(E e)
+	{
+		size_t n = 0;
+		e([&](int, int) { n++; });
+		return n;
+	}
+
+	// バッチャー奇偶マージソート
+	template<int N>
+	struct OddEvenMergeSortNetwork
+	{
+		static constexpr auto Enum = [](auto f) { EnumOddEvenMergeSort(N, f); };
+		static constexpr ComparatorSchedule<CountSchedule(Enum)> schedule = MakeSchedule<CountSchedule(Enum)>(Enum);
+	};
+
+	// 長さ2Kのバイトニック列のマージ
+	template<int N, int K = N / 2>
+	struct HalfCleanerNetwork
+	{
+		static constexpr auto Enum = [](auto f) { EnumHalfCleaner(N, K, f); };
+		static constexpr ComparatorSchedule<CountSchedule(Enum)> schedule = MakeSchedule<CountSchedule(Enum)>(Enum);
+	};
+
+	// 昇順の列と降順の列の突き合わせ
+	template<int N>
+	struct FlipNetwork
+	{
+		static constexpr auto Enum = [](auto f) { EnumFlip(N, f); };
+		static constexpr ComparatorSchedule<CountSchedule(Enum)> schedule = MakeSchedule<CountSchedule(Enum)>(Enum);
+	};
+
+	// バイトニックソートのレジスタ間の1段。N本ずつG組
+	template<int N, int J, int K, int G = 1>
+	struct BitonicStageNetwork
+	{
+		static constexpr auto Enum = [](auto f) { EnumBitonicStage(N, J, K, G, f); };
+		static constexpr ComparatorSchedule<CountSchedule(Enum)> schedule = MakeSchedule<CountSchedule(Enum)>(Enum);
+	};
+
+	template<typename Network, typename Cmp, typename Regs, size_t... I>
+	SUPERSORT_FORCEINLINE void ApplyNetworkImpl(Cmp cmp, Regs regs, std::index_sequence<I...>)
+	{
+		(cmp(std::get<Network::schedule.pair[I].lo>(regs), std::get<Network::schedule.pair[I].hi>(regs)), ...);
+	}
+
+	// 比較器の並びをレジスタに適用する
+	// ApplyNetwork<OddEvenMergeSortNetwork<8>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);
+	template<typename Network, typename Cmp, typename... V>
+	SUPERSORT_FORCEINLINE void ApplyNetwork(Cmp cmp, V&... m)
+	{
+		constexpr size_t count = sizeof(Network::schedule.pair) / sizeof(ComparatorPair);
+		ApplyNetworkImpl<Network>(cmp, std::tie(m...), std::make_index_sequence<count>());
+	}
+
+	template<typename Network, typename Cmp, typename V, size_t... I>
+	SUPERSORT_FORCEINLINE void ApplyNetworkArrayImpl(Cmp cmp, V* m, std::index_sequence<I...>)
+	{
+		(cmp(m[Network::schedule.pair[I].lo], m[Network::schedule.pair[I].hi]), ...);
+	}
+
+	// 比較器の並びをレジスタの配列に適用する。添字は定数なので配列はレジスタに割り当てられる
+	template<typename Network, typename Cmp, typename V>
+	SUPERSORT_FORCEINLINE void ApplyNetworkArray(Cmp cmp, V* m)
+	{
+		constexpr size_t count = sizeof(Network::schedule.pair) / sizeof(ComparatorPair);
+		ApplyNetworkArrayImpl<Network>(cmp, m, std::make_index_sequence<count>());
+	}
+} // namespace
+
+#ifndef SUPERSORTNETWORK_SCHEDULE_ONLY
+namespace {
+	SUPERSORT_FORCEINLINE void CompareExchange(__m256i& lo, __m256i& hi)
+	{
+		__m256i t = _mm256_min_epi32(lo, hi);
+		hi = _mm256_max_epi32(lo, hi);
+		lo = t;
+	}
+
+	// レジスタrの中で要素番号の距離J(8未満)、ブロック長Kのバイトニックソートの1段を行う
+	// 距離Jの相手と入れ替えたものと比較し、昇順のブロックでは上側のレーンに大きい方を残す
+	template<int J, int K, int r>
+	SUPERSORT_FORCEINLINE void LaneStage(__m256i& v)
+	{
+		constexpr int upper = J == 1 ? 0xAA : J == 2 ? 0xCC : 0xF0;
+		constexpr int dir = K == 2 ? 0xCC : K == 4 ? 0xF0 : 0x00;
+		constexpr int flip = ((r * 8) & K) ? 0xFF : 0x00;
+		__m256i t;
+		if constexpr (J == 1)
+		{
+			t = _mm256_shuffle_epi32(v, 0xB1);
+		}
+		else if constexpr (J == 2)
+		{
+			t = _mm256_shuffle_epi32(v, 0x4E);
+		}
+		else
+		{
+			t = _mm256_permute2x128_si256(v, v, 0x01);
+		}
+		__m256i lo = _mm256_min_epi32(v, t);
+		__m256i hi = _mm256_max_epi32(v, t);
+		v = _mm256_blend_epi32(lo, hi, upper ^ dir ^ flip);
+	}
+
+	// I番目にはI / G番目のレジスタをG組分続けて並べる
+	template<int R, int G, int J, int K, size_t... I>
+	SUPERSORT_FORCEINLINE void LaneStages(__m256i* m, std::index_sequence<I...>)
+	{
+		(LaneStage<J, K, (int)I / G>(m[(I % G) * R + I / G]), ...);
+	}
+
+	// 要素番号の距離J、ブロック長Kのバイトニックソートの1段をR本ずつG組のレジスタに適用する
+	// 距離が8以上ならレジスタ間の比較器の並び、8未満ならレジスタ内のシャッフルを生成する
+	template<int R, int J, int K, int G>
+	SUPERSORT_FORCEINLINE void BitonicStage(__m256i* m)
+	{
+		if constexpr (J >= 8)
+		{
+			ApplyNetworkArray<BitonicStageNetwork<R, J / 8, K / 8, G>>(CompareExchange, m);
+		}
+		else
+		{
+			LaneStages<R, G, J, K>(m, std::make_index_sequence<R * G>());
+		}
+	}
+
+	// ブロック長Kのバイトニック列を距離J以下の段でマージする
+	template<int R, int J, int K, int G>
+	SUPERSORT_FORCEINLINE void BitonicMerge(__m256i* m)
+	{
+		BitonicStage<R, J, K, G>(m);
+		if constexpr (J > 1)
+		{
+			BitonicMerge<R, J / 2, K, G>(m);
+		}
+	}
+
+	// R本のレジスタに格納された8*R要素をバイトニックソートする
+	// G組の独立した列を並べた場合は、組毎の依存の連鎖を交互に進める
+	template<int R, int K = 2, int G = 1>
+	SUPERSORT_FORCEINLINE void BitonicSortReg(__m256i* m)
+	{
+		BitonicMerge<R, K / 2, K, G>(m);
+		if constexpr (K < 8 * R)
+		{
+			BitonicSortReg<R, K * 2, G>(m);
+		}
+	}
+
+	// 8*R要素以下のデータをR本のレジスタにマスクロードしてソートする
+	// 足りない分はPADDING_MAXで埋め、num要素分だけマスクストアする
+	template<int R>
+	void SuperSortNet(T* array, size_t num)
+	{
+		__m256i m[R];
+		__m256i mask[R];
+		__m256i padding = _mm256_set1_epi32(PADDING_MAX);
+		__m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		for (int r = 0; r < R; r++)
+		{
+			mask[r] = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)num - r * 8), index);
+			m[r] = _mm256_blendv_epi8(padding, _mm256_maskload_epi32((const int*)array + r * 8, mask[r]), mask[r]);
+		}
+		BitonicSortReg<R>(m);
+		for (int r = 0; r < R; r++)
+		{
+			_mm256_maskstore_epi32((int*)array + r * 8, mask[r], m[r]);
+		}
+	}
+
+	// 8*R要素以下の配列G個をまとめてソートする。各配列の要素数はnums[g]
+	template<int R, int G>
+	void SuperSortNetGroup(T* const* arrays, const size_t* nums)
+	{
+		__m256i m[R * G];
+		__m256i padding = _mm256_set1_epi32(PADDING_MAX);
+		__m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		for (int g = 0; g < G; g++)
+		{
+			for (int r = 0; r < R; r++)
+			{
+				__m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)nums[g] - r * 8), index);
+				m[g * R + r] = _mm256_blendv_epi8(padding, _mm256_maskload_epi32((const int*)arrays[g] + r * 8, mask), mask);
+			}
+		}
+		BitonicSortReg<R, 2, G>(m);
+		for (int g = 0; g < G; g++)
+		{
+			for (int r = 0; r < R; r++)
+			{
+				__m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)nums[g] - r * 8), index);
+				_mm256_maskstore_epi32((int*)arrays[g] + r * 8, mask, m[g * R + r]);
+			}
+		}
+	}
+
+	// 32要素以下のソート。要素数に応じて1、2、4本のレジスタのネットワークを選ぶ
+	void SuperSortTiny(T* array, size_t num)
+	{
+		if (num <= 1)
+		{
+			return;
+		}
+		if (num <= 8)
+		{
+			SuperSortNet<1>(array, num);
+		}
+		else if (num <= 16)
+		{
+			SuperSortNet<2>(array, num);
+		}
+		else
+		{
+			SuperSortNet<4>(array, num);
+		}
+	}
+} // namespace
+#endif
@@ -16,29 +16,134 @@
 #include <stdio.h>
 #include <memory>
 #include <immintrin.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "SuperSort.h"
+#include "SuperSortVector.h"
+#include "SuperQuickSort.h"
 
-#ifdef SUPERSORT_UNSIGNED
+#if defined(SUPERSORT_DESCENDING)
+	// ~̏ꍇ͔rmin/maxւApfBOɂ͍ŏlg
+	// J֐SuperSortDescɂȂ
+	namespace {
+	#ifdef SUPERSORT_UNSIGNED
+		typedef unsigned int T;
+		const T PADDING_MAX = 0;
+		__m256i DescendingMax(__m256i a, __m256i b) { return _mm256_min_epu32(a, b); }
+		__m256i DescendingMin(__m256i a, __m256i b) { return _mm256_max_epu32(a, b); }
+	#else
+		typedef int T;
+		const T PADDING_MAX = -0x7FFFFFFF - 1;
+		__m256i DescendingMax(__m256i a, __m256i b) { return _mm256_min_epi32(a, b); }
+		__m256i DescendingMin(__m256i a, __m256i b) { return _mm256_max_epi32(a, b); }
+	#endif
+	} // namespace
+	#define _mm256_max_epi32 DescendingMax
+	#define _mm256_min_epi32 DescendingMin
+	#define SUPERSORT_GREATER(a, b) ((a) < (b))
+	#define SuperSort SuperSortDesc
+	#define SUPERSORT_SORT_ONLY
+#elif defined(SUPERSORT_KEY_ABS) || defined(SUPERSORT_KEY_FLOAT)
+	// L[ϊ̏ꍇ͏ۂȂ̃L[ɕϊďɃ\[g
+	// ϊ͍Ɨ̈ւ̃Rs[Ə߂̒ōŝŁAϊ̂߂̃pX͑Ȃ
+	// J֐SuperSortAbsASuperSortFɂȂ
+	#define SUPERSORT_KEY
 	typedef unsigned int T;
 	const T PADDING_MAX = 0xFFFFFFFFU;
 	#define _mm256_max_epi32 _mm256_max_epu32
 	#define _mm256_min_epi32 _mm256_min_epu32
+	#define SUPERSORT_GREATER(a, b) ((a) > (b))
+	namespace {
+	#ifdef SUPERSORT_KEY_ABS
+		// WOUOB0, -1, 1, -2, 2, ...0, 1, 2, 3, 4, ...ɂȂ
+		__m256i EncodeKey(__m256i m) { return _mm256_xor_si256(_mm256_slli_epi32(m, 1), _mm256_srai_epi32(m, 31)); }
+		__m256i DecodeKey(__m256i m) { return _mm256_xor_si256(_mm256_srli_epi32(m, 1), _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(m, _mm256_set1_epi32(1)))); }
+	#else
+		// ̒l͑SrbgA̒l͕rbg𔽓]
+		__m256i EncodeKey(__m256i m) { return _mm256_xor_si256(m, _mm256_or_si256(_mm256_srai_epi32(m, 31), _mm256_set1_epi32(-0x7FFFFFFF - 1))); }
+		__m256i DecodeKey(__m256i m) { return _mm256_xor_si256(m, _mm256_or_si256(_mm256_andnot_si256(_mm256_srai_epi32(m, 31), _mm256_set1_epi32(-1)), _mm256_set1_epi32(-0x7FFFFFFF - 1))); }
+	#endif
+	} // namespace
+	#ifdef SUPERSORT_KEY_ABS
+		#define SuperSort SuperSortAbsKeys
+	#else
+		#define SuperSort SuperSortFKeys
+	#endif
+	#define SUPERSORT_SORT_ONLY
+#elif defined(SUPERSORT_UNSIGNED)
+	typedef unsigned int T;
+	const T PADDING_MAX = 0xFFFFFFFFU;
+	#define _mm256_max_epi32 _mm256_max_epu32
+	#define _mm256_min_epi32 _mm256_min_epu32
+	#define SUPERSORT_GREATER(a, b) ((a) > (b))
 #else
 	typedef int T;
 	const T PADDING_MAX = 0x7FFFFFFF;
+	#define SUPERSORT_GREATER(a, b) ((a) > (b))
+#endif
+
+#include "SuperSortNetwork.h"
+
+// 1^C̃ubN(32vf)BƗ̈ƍ킹L2Ɏ܂傫ɂ
+#ifndef SUPERSORT_TILE_BLOCKS
+#define SUPERSORT_TILE_BLOCKS 1024
+#endif
+// }[W؂ňxɃ}[W̐
+#ifndef SUPERSORT_MERGE_WAYS
+#define SUPERSORT_MERGE_WAYS 32
+#endif
+// }[W؂̊em[h̏o̓obt@̃ubN
+#ifndef SUPERSORT_MERGE_FIFO
+#define SUPERSORT_MERGE_FIFO 64
+#endif
+// ̗vfȏł͍ŏIȉo͂me|XgAŏoBXgxLbV\傫
+#ifndef SUPERSORT_STREAM_THRESHOLD
+#define SUPERSORT_STREAM_THRESHOLD (1 << 24)
+#endif
+// \[g1XbhɊ蓖Ăŏ̗vf
+#ifndef SUPERSORT_PARALLEL_MIN
+#define SUPERSORT_PARALLEL_MIN (1 << 16)
 #endif
 
 namespace {
-	void SuperSortAligned(T* array, size_t num);
+	struct UniqueSink;
+	void SuperSortAligned(T* array, size_t num, bool stream = false, UniqueSink* sink = NULL);
+	void StreamCopy(T* dst, const T* src, size_t num);
 	void SuperSort64(T* array, T* dst = NULL);
 	void SuperSort96(T* array, T* dst = NULL);
 	void SuperSort128(T* array, T* dst = NULL);
+#ifdef SUPERSORT_KEY
+	template<bool Decode>
+	void KeyCopy(T* dst, const T* src, size_t num, bool stream = false);
+#endif
 } // namespace
 
 void SuperSort(T* array, size_t num)
 {
+	if (num <= 32)
+	{
+#ifdef SUPERSORT_KEY
+		T tiny[32];
+		KeyCopy<false>(tiny, array, num);
+		SuperSortTiny(tiny, num);
+		KeyCopy<true>(array, tiny, num);
+#else
+		SuperSortTiny(array, num);
+#endif
+		return;
+	}
+#ifdef SUPERSORT_KEY
+	// L[ւ̕ϊ͍Ɨ̈ւ̃Rs[ōŝŁAĂzRs[
+	bool isAligned = false;
+#else
 	bool isAligned = (((size_t)array) & 31) == 0;
+#endif
 	size_t alignedsize;
 	if (num < 64)
 	{
@@ -46,13 +151,13 @@ void SuperSort(T* array, size_t num)
 	}
 	else
 	{
-		alignedsize = (num - 1 | 31) + 1;
+		alignedsize = ((num - 1) | 31) + 1;
 	}
 	if (num == alignedsize && isAligned)
 	{
 		if (alignedsize > 128)
 		{
-			SuperSortAligned(array, alignedsize / 32);
+			SuperSortAligned(array, alignedsize / 32, num >= SUPERSORT_STREAM_THRESHOLD);
 		}
 		if (alignedsize == 64)
 		{
@@ -75,7 +180,11 @@ void SuperSort(T* array, size_t num)
 		{
 			buf[i] = PADDING_MAX;
 		}
+#ifdef SUPERSORT_KEY
+		KeyCopy<false>(buf, array, num);
+#else
 		memcpy(buf, array, sizeof(T) * num);
+#endif
 		if (alignedsize > 128)
 		{
 			SuperSortAligned(buf, alignedsize / 32);
@@ -92,7 +201,23 @@ void SuperSort(T* array, size_t num)
 		{
 			SuperSort128(buf);
 		}
-		memcpy(array, buf, sizeof(T) * num);
+#ifdef SUPERSORT_KEY
+		KeyCopy<true>(array, buf, num, num >= SUPERSORT_STREAM_THRESHOLD);
+		if (num >= SUPERSORT_STREAM_THRESHOLD)
+		{
+			_mm_sfence();
+		}
+#else
+		if (num >= SUPERSORT_STREAM_THRESHOLD)
+		{
+			StreamCopy(array, buf, num);
+			_mm_sfence();
+		}
+		else
+		{
+			memcpy(array, buf, sizeof(T) * num);
+		}
+#endif
 		AlignedFree(buf);
 	}
 }
@@ -109,18 +234,7 @@ namespace {
 
 	// WX^8̃oCgjbN\[gs
 #define LineBitonicSort() \
-		Comparator(m0, m4);\
-		Comparator(m1, m5);\
-		Comparator(m2, m6);\
-		Comparator(m3, m7);\
-		Comparator(m0, m2);\
-		Comparator(m1, m3);\
-		Comparator(m4, m6);\
-		Comparator(m5, m7);\
-		Comparator(m0, m1);\
-		Comparator(m2, m3);\
-		Comparator(m4, m5);\
-		Comparator(m6, m7);
+		ApplyNetwork<HalfCleanerNetwork<8>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);
 
 	// xmmWX^0Ԗڂ2ԖځA1Ԗڂ3Ԗڂ̗vfꂼ\[g
 	auto ComparatorLR2 = [](__m256i& m0, __m256i& m1) {
@@ -160,21 +274,11 @@ namespace {
 
 #define Merge3232() {\
 		m0 = _mm256_permutevar8x32_epi32(m0, maskflip8);\
-		Comparator(m0, m7);\
 		m1 = _mm256_permutevar8x32_epi32(m1, maskflip8);\
-		Comparator(m1, m6);\
 		m2 = _mm256_permutevar8x32_epi32(m2, maskflip8);\
-		Comparator(m2, m5);\
 		m3 = _mm256_permutevar8x32_epi32(m3, maskflip8);\
-		Comparator(m3, m4);\
-		Comparator(m0, m2);\
-		Comparator(m1, m3);\
-		Comparator(m4, m6);\
-		Comparator(m5, m7);\
-		Comparator(m0, m1);\
-		Comparator(m2, m3);\
-		Comparator(m4, m5);\
-		Comparator(m6, m7);\
+		ApplyNetwork<FlipNetwork<8>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);\
+		ApplyNetwork<HalfCleanerNetwork<8, 2>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);\
 		Swapupdn4(m0, m4);\
 		Swapupdn4(m1, m5);\
 		Swapupdn4(m2, m6);\
@@ -220,25 +324,7 @@ namespace {
 		m6 = _mm256_load_si256((__m256i*)(array + 48));
 		m7 = _mm256_load_si256((__m256i*)(array + 56));
 		// 8Ńob`[}[W\[gs
-		Comparator(m0, m1);
-		Comparator(m2, m3);
-		Comparator(m4, m5);
-		Comparator(m6, m7);
-		Comparator(m0, m2);
-		Comparator(m1, m3);
-		Comparator(m4, m6);
-		Comparator(m5, m7);
-		Comparator(m1, m2);
-		Comparator(m5, m6);
-		Comparator(m0, m4);
-		Comparator(m1, m5);
-		Comparator(m2, m6);
-		Comparator(m3, m7);
-		Comparator(m2, m4);
-		Comparator(m3, m5);
-		Comparator(m1, m2);
-		Comparator(m3, m4);
-		Comparator(m5, m6);
+		ApplyNetwork<OddEvenMergeSortNetwork<8>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);
 
 		// 4ŃoCgjbN\[g1is
 		//	DebugPrint();
@@ -301,13 +387,10 @@ namespace {
 
 		__m256i maskflip8 = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
 		m0 = _mm256_permutevar8x32_epi32(m0, maskflip8);
-		Comparator(m0, m7);
 		m1 = _mm256_permutevar8x32_epi32(m1, maskflip8);
-		Comparator(m1, m6);
 		m2 = _mm256_permutevar8x32_epi32(m2, maskflip8);
-		Comparator(m2, m5);
 		m3 = _mm256_permutevar8x32_epi32(m3, maskflip8);
-		Comparator(m3, m4);
+		ApplyNetwork<FlipNetwork<8>>(Comparator, m0, m1, m2, m3, m4, m5, m6, m7);
 
 		ComparatorLR(m0);
 		ComparatorLR(m1);
@@ -441,7 +524,180 @@ namespace {
 		_mm256_store_si256((__m256i*)(dst + 64 + 24), m7);
 	}
 
-	void Merge(T* src1, size_t size1, T* src2, size_t size2, T* dst)
+	// ŏIȉo͂̓LbVɎcĂĂѓǂ܂Ȃ߁AStreamȂme|XgAŏo
+	template<bool Stream>
+	SUPERSORT_FORCEINLINE void StoreOut(__m256i* p, __m256i m)
+	{
+		if constexpr (Stream)
+		{
+			_mm256_stream_si256(p, m);
+		}
+		else
+		{
+			_mm256_store_si256(p, m);
+		}
+	}
+
+	// mask̃rbgĂ郌[̗vfdstɍl߂Ŋi[Ai[vfԂ
+	// dstɂ͏8vf܂
+	size_t LeftPack(T* dst, __m256i m, unsigned int mask)
+	{
+		unsigned long long bytemask = _pdep_u64(mask, 0x0101010101010101ULL) * 0xFF;
+		unsigned long long index = _pext_u64(0x0706050403020100ULL, bytemask);
+		__m256i perm = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128((long long)index));
+		_mm256_storeu_si256((__m256i*)dst, _mm256_permutevar8x32_epi32(m, perm));
+		return _mm_popcnt_u32(mask);
+	}
+
+	// dʂ̏o
+	struct UniqueSink
+	{
+		T* dst;
+		size_t* counts;
+		size_t num;		// pfBOvf
+		size_t pos;		// ܂łɎ󂯎vf
+		size_t n;		// oL[̐
+		size_t start;	// Ō̃L[ŏɌꂽʒu
+		__m256i last;	// OɎ󂯎vfS[ɕׂ
+	};
+
+	// 8vf󂯎AO̗vfƈقȂ郌[l߂ďo
+	SUPERSORT_FORCEINLINE void PutUnique(UniqueSink* sink, __m256i m)
+	{
+		__m256i prev = _mm256_permutevar8x32_epi32(m, _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6));
+		prev = _mm256_blend_epi32(prev, sink->last, 0x01);
+		unsigned int mask = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(m, prev))) & 0xFF;
+		sink->last = _mm256_permutevar8x32_epi32(m, _mm256_set1_epi32(7));
+		if (sink->pos == 0)
+		{
+			mask |= 1;
+		}
+		if (sink->pos + 8 > sink->num)
+		{
+			// pfBÕ[͎̂Ă
+			mask &= sink->pos < sink->num ? (1U << (sink->num - sink->pos)) - 1 : 0;
+		}
+		if (sink->counts)
+		{
+			// VL[ꂽʒu̍ÕL[̌ɂȂ
+			unsigned int bits = mask;
+			size_t k = sink->n;
+			while (bits)
+			{
+				size_t at = sink->pos + _tzcnt_u32(bits);
+				if (k)
+				{
+					sink->counts[k - 1] = at - sink->start;
+				}
+				sink->start = at;
+				k++;
+				bits &= bits - 1;
+			}
+		}
+		if (sink->n + 8 <= sink->num)
+		{
+			sink->n += LeftPack(sink->dst + sink->n, m, mask);
+		}
+		else
+		{
+			T tmp[8];
+			size_t c = LeftPack(tmp, m, mask);
+			memcpy(sink->dst + sink->n, tmp, sizeof(T) * c);
+			sink->n += c;
+		}
+		sink->pos += 8;
+	}
+
+	// 32vf̃ubNoBUniqueȂpɂ͏sink֓n
+	template<bool Stream, bool Unique>
+	SUPERSORT_FORCEINLINE void StoreBlock(T* p, __m256i m0, __m256i m1, __m256i m2, __m256i m3, UniqueSink* sink)
+	{
+		if constexpr (Unique)
+		{
+			PutUnique(sink, m0);
+			PutUnique(sink, m1);
+			PutUnique(sink, m2);
+			PutUnique(sink, m3);
+		}
+		else
+		{
+			StoreOut<Stream>((__m256i*)(p + 0), m0);
+			StoreOut<Stream>((__m256i*)(p + 8), m1);
+			StoreOut<Stream>((__m256i*)(p + 16), m2);
+			StoreOut<Stream>((__m256i*)(p + 24), m3);
+		}
+	}
+
+	// srcdstnumvfme|XgAŃRs[Bdst32oCgEɑĂȂĂ悢
+	void StreamCopy(T* dst, const T* src, size_t num)
+	{
+		size_t i = 0;
+		while (i < num && (((size_t)(dst + i)) & 31))
+		{
+			dst[i] = src[i];
+			i++;
+		}
+		for (; i + 8 <= num; i += 8)
+		{
+			_mm256_stream_si256((__m256i*)(dst + i), _mm256_loadu_si256((const __m256i*)(src + i)));
+		}
+		for (; i < num; i++)
+		{
+			dst[i] = src[i];
+		}
+	}
+
+#ifdef SUPERSORT_KEY
+	template<bool Decode>
+	__m256i ConvertKey(__m256i m)
+	{
+		if constexpr (Decode)
+		{
+			return DecodeKey(m);
+		}
+		else
+		{
+			return EncodeKey(m);
+		}
+	}
+
+	template<bool Decode>
+	T ConvertKey(T x)
+	{
+		return (T)_mm256_cvtsi256_si32(ConvertKey<Decode>(_mm256_set1_epi32((int)x)));
+	}
+
+	// srcL[ɕϊ(DecodeȂ猳̒lɖ߂)dstɃRs[BstreamȂme|XgAg
+	template<bool Decode>
+	void KeyCopy(T* dst, const T* src, size_t num, bool stream)
+	{
+		size_t i = 0;
+		if (stream)
+		{
+			while (i < num && (((size_t)(dst + i)) & 31))
+			{
+				dst[i] = ConvertKey<Decode>(src[i]);
+				i++;
+			}
+			for (; i + 8 <= num; i += 8)
+			{
+				_mm256_stream_si256((__m256i*)(dst + i), ConvertKey<Decode>(_mm256_loadu_si256((const __m256i*)(src + i))));
+			}
+		}
+		for (; i + 8 <= num; i += 8)
+		{
+			_mm256_storeu_si256((__m256i*)(dst + i), ConvertKey<Decode>(_mm256_loadu_si256((const __m256i*)(src + i))));
+		}
+		for (; i < num; i++)
+		{
+			dst[i] = ConvertKey<Decode>(src[i]);
+		}
+	}
+#endif
+
+	// UniqueȂdstɂ͏Adsink֏o
+	template<bool Stream = false, bool Unique = false>
+	void Merge(T* src1, size_t size1, T* src2, size_t size2, T* dst, UniqueSink* sink = NULL)
 	{
 		size_t i, j;
 		i = j = 1;
@@ -457,16 +713,13 @@ namespace {
 		m6 = _mm256_load_si256((__m256i*)(src2 + 16));
 		m7 = _mm256_load_si256((__m256i*)(src2 + 24));
 		Merge3232();
-		_mm256_store_si256((__m256i*)(dst + 0), m0);
-		_mm256_store_si256((__m256i*)(dst + 8), m1);
-		_mm256_store_si256((__m256i*)(dst + 16), m2);
-		_mm256_store_si256((__m256i*)(dst + 24), m3);
+		StoreBlock<Stream, Unique>(dst, m0, m1, m2, m3, sink);
 		src1 += 32;
 		src2 += 32;
 		dst += 32;
 		while (1)
 		{
-			if (src1[0] > src2[0])
+			if (SUPERSORT_GREATER(src1[0], src2[0]))
 			{
 				m0 = _mm256_load_si256((__m256i*)(src2 + 0));
 				m1 = _mm256_load_si256((__m256i*)(src2 + 8));
@@ -475,10 +728,7 @@ namespace {
 				src2 += 32;
 				j++;
 				Merge3232();
-				_mm256_store_si256((__m256i*)(dst + 0), m0);
-				_mm256_store_si256((__m256i*)(dst + 8), m1);
-				_mm256_store_si256((__m256i*)(dst + 16), m2);
-				_mm256_store_si256((__m256i*)(dst + 24), m3);
+				StoreBlock<Stream, Unique>(dst, m0, m1, m2, m3, sink);
 				dst += 32;
 				if (j == size2)
 				{
@@ -491,10 +741,7 @@ namespace {
 						src1 += 32;
 						i++;
 						Merge3232();
-						_mm256_store_si256((__m256i*)(dst + 0), m0);
-						_mm256_store_si256((__m256i*)(dst + 8), m1);
-						_mm256_store_si256((__m256i*)(dst + 16), m2);
-						_mm256_store_si256((__m256i*)(dst + 24), m3);
+						StoreBlock<Stream, Unique>(dst, m0, m1, m2, m3, sink);
 						dst += 32;
 					}
 					break;
@@ -509,10 +756,7 @@ namespace {
 				src1 += 32;
 				i++;
 				Merge3232();
-				_mm256_store_si256((__m256i*)(dst + 0), m0);
-				_mm256_store_si256((__m256i*)(dst + 8), m1);
-				_mm256_store_si256((__m256i*)(dst + 16), m2);
-				_mm256_store_si256((__m256i*)(dst + 24), m3);
+				StoreBlock<Stream, Unique>(dst, m0, m1, m2, m3, sink);
 				dst += 32;
 				if (i == size1)
 				{
@@ -525,30 +769,37 @@ namespace {
 						src2 += 32;
 						j++;
 						Merge3232();
-						_mm256_store_si256((__m256i*)(dst + 0), m0);
-						_mm256_store_si256((__m256i*)(dst + 8), m1);
-						_mm256_store_si256((__m256i*)(dst + 16), m2);
-						_mm256_store_si256((__m256i*)(dst + 24), m3);
+						StoreBlock<Stream, Unique>(dst, m0, m1, m2, m3, sink);
 						dst += 32;
 					}
 					break;
 				}
 			}
 		}
-		_mm256_store_si256((__m256i*)(dst + 0), m4);
-		_mm256_store_si256((__m256i*)(dst + 8), m5);
-		_mm256_store_si256((__m256i*)(dst + 16), m6);
-		_mm256_store_si256((__m256i*)(dst + 24), m7);
+		StoreBlock<Stream, Unique>(dst, m4, m5, m6, m7, sink);
 	}
 
 
-	void SuperSortRec(T* src, T* dst, T* org, size_t num)
+	// streamȂŏĩ}[Wme|XgAŏo
+	// sink΍ŏĩ}[W͏dsink֏o
+	void SuperSortRec(T* src, T* dst, T* org, size_t num, bool stream = false, UniqueSink* sink = NULL)
 	{
 		if (num > 4)
 		{
 			SuperSortRec(dst, src, org, num / 2);
 			SuperSortRec(dst + num / 2 * 32, src + num / 2 * 32, org + num / 2 * 32, num - num / 2);
-			Merge(src, num / 2, src + num / 2 * 32, num - num / 2, dst);
+			if (sink)
+			{
+				Merge<false, true>(src, num / 2, src + num / 2 * 32, num - num / 2, dst, sink);
+			}
+			else if (stream)
+			{
+				Merge<true>(src, num / 2, src + num / 2 * 32, num - num / 2, dst);
+			}
+			else
+			{
+				Merge(src, num / 2, src + num / 2 * 32, num - num / 2, dst);
+			}
 		}
 		else
 		{
@@ -567,10 +818,758 @@ namespace {
 		}
 	}
 
-	void SuperSortAligned(T* array, size_t num)
+	// }[W؂̃m[h
+	// 2̎qubN̐擪vfɎoă}[WAo̓obt@ɒ߂
+	// t̓\[gς݂̗񂻂̂̂o̓obt@ƂĎ
+	struct MergeNode
+	{
+		T* buf;
+		size_t capacity;
+		size_t head;
+		size_t count;
+		bool done;
+		bool hasCarry;
+		MergeNode* child[2];
+		__m256i carry[4];
+	};
+
+	// o̓obt@ɂȂm[hɎ̃ubN
+	// StreamUniquẽ͍m[hŏIIȏo͐ɏoꍇɂg
+	template<bool Stream, bool Unique = false>
+	void Refill(MergeNode* node, UniqueSink* sink = NULL)
+	{
+		__m256i m0, m1, m2, m3;
+		__m256i maskflip8 = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+		bool hasCarry = node->hasCarry;
+		size_t n = 0;
+		// JzԂ͎gȂAǂ̌oHłl܂悤ɏĂ
+		__m256i m4 = _mm256_setzero_si256();
+		__m256i m5 = _mm256_setzero_si256();
+		__m256i m6 = _mm256_setzero_si256();
+		__m256i m7 = _mm256_setzero_si256();
+		if (hasCarry)
+		{
+			m4 = node->carry[0];
+			m5 = node->carry[1];
+			m6 = node->carry[2];
+			m7 = node->carry[3];
+		}
+		while (n < node->capacity)
+		{
+			MergeNode* next = NULL;
+			int c;
+			for (c = 0; c < 2; c++)
+			{
+				MergeNode* ch = node->child[c];
+				if (ch->count == 0 && !ch->done)
+				{
+					Refill<false>(ch);
+				}
+				if (ch->count && (!next || SUPERSORT_GREATER(next->buf[next->head * 32], ch->buf[ch->head * 32])))
+				{
+					next = ch;
+				}
+			}
+			if (!next)
+			{
+				// qsco͂ďI
+				if (hasCarry)
+				{
+					StoreBlock<Stream, Unique>(node->buf + n * 32, m4, m5, m6, m7, sink);
+					hasCarry = false;
+					n++;
+				}
+				node->done = true;
+				break;
+			}
+			T* p = next->buf + next->head * 32;
+			next->head++;
+			next->count--;
+			if (!hasCarry)
+			{
+				m4 = _mm256_load_si256((__m256i*)(p + 0));
+				m5 = _mm256_load_si256((__m256i*)(p + 8));
+				m6 = _mm256_load_si256((__m256i*)(p + 16));
+				m7 = _mm256_load_si256((__m256i*)(p + 24));
+				hasCarry = true;
+				continue;
+			}
+			m0 = _mm256_load_si256((__m256i*)(p + 0));
+			m1 = _mm256_load_si256((__m256i*)(p + 8));
+			m2 = _mm256_load_si256((__m256i*)(p + 16));
+			m3 = _mm256_load_si256((__m256i*)(p + 24));
+			Merge3232();
+			StoreBlock<Stream, Unique>(node->buf + n * 32, m0, m1, m2, m3, sink);
+			n++;
+		}
+		if (hasCarry)
+		{
+			node->carry[0] = m4;
+			node->carry[1] = m5;
+			node->carry[2] = m6;
+			node->carry[3] = m7;
+		}
+		node->hasCarry = hasCarry;
+		node->head = 0;
+		node->count = n;
+	}
+
+	// \[gς݂runs{̗(ubNlens)}[W؂ňxdstփ}[W
+	// runs{̗̃}[W؂Btbuf͌ĂяoŐݒ肷
+	// rootBufɈxrootCapacityubN܂ŏo͂AȊO̓m[h̏o̓obt@fifo犄蓖Ă
+	void BuildMergeTree(MergeNode* nodes, const size_t* lens, size_t runs, T* fifo, T* rootBuf, size_t rootCapacity)
+	{
+		size_t i;
+		// m[hi̎q2i+12i+2Bruns-1ȍ~t
+		for (i = 0; i < runs - 1; i++)
+		{
+			MergeNode& node = nodes[i];
+			node.buf = i ? fifo + (i - 1) * SUPERSORT_MERGE_FIFO * 32 : rootBuf;
+			node.capacity = i ? SUPERSORT_MERGE_FIFO : rootCapacity;
+			node.head = node.count = 0;
+			node.done = node.hasCarry = false;
+			node.child[0] = &nodes[i * 2 + 1];
+			node.child[1] = &nodes[i * 2 + 2];
+		}
+		for (i = 0; i < runs; i++)
+		{
+			MergeNode& leaf = nodes[runs - 1 + i];
+			leaf.head = 0;
+			leaf.count = lens[i];
+			leaf.done = true;
+		}
+	}
+
+	// sinkdstɂ͏Adsink֏o
+	void MultiwayMerge(T* src, const size_t* lens, size_t runs, T* dst, bool stream, UniqueSink* sink = NULL)
+	{
+		size_t i, total = 0;
+		for (i = 0; i < runs; i++)
+		{
+			total += lens[i];
+		}
+		if (runs == 1)
+		{
+			if (sink)
+			{
+				for (i = 0; i < total; i++)
+				{
+					T* p = src + i * 32;
+					StoreBlock<false, true>(NULL, _mm256_load_si256((__m256i*)(p + 0)), _mm256_load_si256((__m256i*)(p + 8)), _mm256_load_si256((__m256i*)(p + 16)), _mm256_load_si256((__m256i*)(p + 24)), sink);
+				}
+			}
+			else if (stream)
+			{
+				StreamCopy(dst, src, total * 32);
+			}
+			else
+			{
+				memcpy(dst, src, sizeof(T) * total * 32);
+			}
+			return;
+		}
+		SuperSortVector<MergeNode> nodes(runs * 2 - 1);
+		T* fifo = (T*)AlignedMalloc(sizeof(T) * SUPERSORT_MERGE_FIFO * 32 * (runs - 1));
+		BuildMergeTree(nodes.data(), lens, runs, fifo, dst, total);
+		for (i = 0; i < runs; i++)
+		{
+			nodes[runs - 1 + i].buf = src;
+			src += lens[i] * 32;
+		}
+		if (sink)
+		{
+			Refill<false, true>(&nodes[0], sink);
+		}
+		else if (stream)
+		{
+			Refill<true>(&nodes[0]);
+		}
+		else
+		{
+			Refill<false>(&nodes[0]);
+		}
+		AlignedFree(fifo);
+	}
+
+	// L2Ɏ܂^CɃ\[gĂA}[W؂ł܂Ƃ߂ă}[W
+	// DRAM񐔂2؂̃}[W̒ił͂Ȃlog(^C)/log(SUPERSORT_MERGE_WAYS)ɂȂ
+	// streamȂŏIĩ}[Wme|XgAŏo
+	// sink΍ŏIĩ}[W͏dsink֏oAarrayɂ͌ʂcȂ
+	void SuperSortAligned(T* array, size_t num, bool stream, UniqueSink* sink)
 	{
 		T* buf = (T*)AlignedMalloc(sizeof(T) * num * 32);
-		SuperSortRec(buf, array, array, num);
+		if (num <= SUPERSORT_TILE_BLOCKS * 2)
+		{
+			SuperSortRec(buf, array, array, num, stream, sink);
+		}
+		else
+		{
+			// ^C̑傫ϓɂāAǂ̃^C2ubNȏɂ
+			size_t tiles = (num + SUPERSORT_TILE_BLOCKS - 1) / SUPERSORT_TILE_BLOCKS;
+			SuperSortVector<size_t> lens(tiles);
+			// }[W̒iȂ^CbufɁAȂarrayɒuƁAŌarrayŏI
+			size_t runs = tiles;
+			bool odd = false;
+			while (runs > 1)
+			{
+				runs = (runs + SUPERSORT_MERGE_WAYS - 1) / SUPERSORT_MERGE_WAYS;
+				odd = !odd;
+			}
+			T* src = odd ? buf : array;
+			T* dst = odd ? array : buf;
+			size_t t;
+			for (t = 0; t < tiles; t++)
+			{
+				size_t begin = num * t / tiles;
+				lens[t] = num * (t + 1) / tiles - begin;
+				SuperSortRec(dst + begin * 32, src + begin * 32, array + begin * 32, lens[t]);
+			}
+			while (lens.size() > 1)
+			{
+				bool last = lens.size() <= SUPERSORT_MERGE_WAYS;
+				SuperSortVector<size_t> merged;
+				size_t g, ofs = 0;
+				for (g = 0; g < lens.size(); g += SUPERSORT_MERGE_WAYS)
+				{
+					size_t runs = lens.size() - g < SUPERSORT_MERGE_WAYS ? lens.size() - g : SUPERSORT_MERGE_WAYS;
+					size_t sum = 0, r;
+					for (r = 0; r < runs; r++)
+					{
+						sum += lens[g + r];
+					}
+					MultiwayMerge(src + ofs * 32, &lens[g], runs, dst + ofs * 32, stream && last, last ? sink : NULL);
+					merged.push_back(sum);
+					ofs += sum;
+				}
+				lens.swap(merged);
+				T* tmp = src;
+				src = dst;
+				dst = tmp;
+			}
+		}
+		if (stream)
+		{
+			_mm_sfence();
+		}
 		AlignedFree(buf);
 	}
 } // namespace
+
+#ifndef SUPERSORT_SORT_ONLY
+namespace {
+	// runs{̗Ŝ珬kvf鎞ɁAe񂩂vfsplitɋ߂
+	// l͗̏Ɋ蓖Ă̂ŁAsplitkɂĒPɂȂ
+	void CoRank(T* const* run, const size_t* len, size_t runs, size_t k, size_t* split)
+	{
+		size_t r;
+		long long lo = (std::numeric_limits<T>::min)();
+		long long hi = (std::numeric_limits<T>::max)();
+		// lvȉ̗vfkȏɂȂŏv߂
+		while (lo < hi)
+		{
+			long long mid = lo + (hi - lo) / 2;
+			size_t count = 0;
+			for (r = 0; r < runs; r++)
+			{
+				count += std::upper_bound(run[r], run[r] + len[r], (T)mid) - run[r];
+			}
+			if (count >= k)
+			{
+				hi = mid;
+			}
+			else
+			{
+				lo = mid + 1;
+			}
+		}
+		size_t rest = k;
+		for (r = 0; r < runs; r++)
+		{
+			split[r] = std::lower_bound(run[r], run[r] + len[r], (T)lo) - run[r];
+			rest -= split[r];
+		}
+		for (r = 0; r < runs && rest; r++)
+		{
+			size_t eq = std::upper_bound(run[r] + split[r], run[r] + len[r], (T)lo) - run[r] - split[r];
+			size_t take = eq < rest ? eq : rest;
+			split[r] += take;
+			rest -= take;
+		}
+	}
+
+	// SXbh܂ő҂B1񂾂g
+	// ҂Ԃ̓\[g}[W̕΂ŒȂ邱Ƃ̂ŁA񂳂ɖđ҂
+	class ArrivalBarrier
+	{
+	public:
+		ArrivalBarrier(int threads) : m_rest(threads) {}
+		void Arrive()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if (--m_rest == 0)
+			{
+				lock.unlock();
+				m_cond.notify_all();
+				return;
+			}
+			m_cond.wait(lock, [this]() { return m_rest == 0; });
+		}
+
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_cond;
+		int m_rest;
+	};
+
+	// eXbhS͈͂̍Ɨ̈ɃRs[ă\[gASXbh̗񂪑
+	// o͂̒S͈͂ɓfЂe񂩂W߂ĈxɃ}[W
+	// ͂Əo͂̒S͈͓͂Ȃ̂ŁAeXbh͔z͈̎̔͂ǂݏA
+	// m[h܂ǂݏo͍Ō̃}[WŊevf1񂾂ɂȂ
+	// cancelꍇ͍Ō̃}[W̑OɒffalseԂBz̓}[W܂ŏȂ̂Ō̂܂܎c
+	bool SuperSortParallelImpl(T* array, size_t num, int threads, bool numa, const std::atomic<bool>* cancel, void (*sort)(T*, size_t))
+	{
+		if (threads <= 0)
+		{
+			threads = (int)std::thread::hardware_concurrency();
+		}
+		if ((size_t)threads > num / SUPERSORT_PARALLEL_MIN)
+		{
+			threads = (int)(num / SUPERSORT_PARALLEL_MIN);
+		}
+		if (threads <= 1)
+		{
+			sort(array, num);
+			return true;
+		}
+		int nodes = numa ? SuperSortNumaNodes() : 1;
+		auto begin = [&](int t) { return num * t / threads; };
+		SuperSortVector<T*> run(threads);
+		SuperSortVector<size_t> len(threads);
+		ArrivalBarrier sorted(threads), merged(threads);
+		// f邩ǂ͍ŏɓXbh߁ASXbhfɏ]
+		std::atomic<int> stop(-1);
+
+		auto work = [&](int t) {
+			// Ɨ̈̓m[hɊ蓖ĂĂmۂÃXbhōŏɐG
+			if (numa)
+			{
+				SuperSortBindNode(t * nodes / threads);
+			}
+			size_t n = begin(t + 1) - begin(t);
+			size_t padded = (n + 31) & ~(size_t)31;
+			size_t i, r;
+			T* buf = (T*)AlignedMalloc(sizeof(T) * padded);
+			memcpy(buf, array + begin(t), sizeof(T) * n);
+			for (i = n; i < padded; i++)
+			{
+				buf[i] = PADDING_MAX;
+			}
+			sort(buf, padded);
+			run[t] = buf;
+			len[t] = n;
+			sorted.Arrive();
+			int undecided = -1;
+			stop.compare_exchange_strong(undecided, cancel && cancel->load() ? 1 : 0);
+			if (stop.load())
+			{
+				AlignedFree(buf);
+				return;
+			}
+
+			// e̒fЂ32vfPʂɐ؂グĕׁA}[W؂ňxɃ}[W
+			SuperSortVector<size_t> lower(threads), upper(threads), lens;
+			CoRank(run.data(), len.data(), threads, begin(t), lower.data());
+			CoRank(run.data(), len.data(), threads, begin(t + 1), upper.data());
+			size_t blocks = 0;
+			for (r = 0; r < (size_t)threads; r++)
+			{
+				blocks += (upper[r] - lower[r] + 31) / 32;
+			}
+			T* tmp = (T*)AlignedMalloc(sizeof(T) * blocks * 32);
+			T* out = (T*)AlignedMalloc(sizeof(T) * blocks * 32);
+			T* p = tmp;
+			for (r = 0; r < (size_t)threads; r++)
+			{
+				size_t m = upper[r] - lower[r];
+				if (m == 0)
+				{
+					continue;
+				}
+				memcpy(p, run[r] + lower[r], sizeof(T) * m);
+				for (i = m; i % 32; i++)
+				{
+					p[i] = PADDING_MAX;
+				}
+				lens.push_back(i / 32);
+				p += i;
+			}
+			if (lens.size())
+			{
+				MultiwayMerge(tmp, lens.data(), lens.size(), out, false);
+				memcpy(array + begin(t), out, sizeof(T) * n);
+			}
+			AlignedFree(tmp);
+			AlignedFree(out);
+			// ̃Xbh̗ǂݏI܂ŉȂ
+			merged.Arrive();
+			AlignedFree(buf);
+		};
+
+		// NUMȀꍇ͌ĂяõXbhŒ肵Ȃ悤ASẴXbhVɍ
+		// [J[Xbh͌ĂяõA[iƓvg
+		SuperSortScratchContext scratch;
+		SuperSortVector<std::thread> pool;
+		int t;
+		for (t = numa ? 0 : 1; t < threads; t++)
+		{
+			pool.emplace_back([&scratch, &work](int i) { SuperSortScratchScope scope(scratch); work(i); }, t);
+		}
+		if (!numa)
+		{
+			work(0);
+		}
+		for (auto& th : pool)
+		{
+			th.join();
+		}
+		return stop.load() == 0;
+	}
+} // namespace
+
+bool SuperSortParallel(T* array, size_t num, int threads, bool numa, const std::atomic<bool>* cancel)
+{
+	return SuperSortParallelImpl(array, num, threads, numa, cancel, SuperSort);
+}
+
+bool SuperQuickSortParallel(T* array, size_t num, int threads, bool numa, const std::atomic<bool>* cancel)
+{
+	return SuperSortParallelImpl(array, num, threads, numa, cancel, SuperQuickSort);
+}
+#endif
+
+#ifndef SUPERSORT_SORT_ONLY
+// ʁẌ̗ɂ\[gς݂̗}[WA擪numvfdstɏ
+// e32oCgEn܂Alens[i]ubN(32vfP)
+// ̏o͂̓LbVɍڂ傫̃obt@oR̂ŁAdst̃ACg͖Ȃ
+void SuperMergeRuns(T* const* runs, const size_t* lens, size_t count, T* dst, size_t num)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	if (count == 1)
+	{
+		memcpy(dst, runs[0], sizeof(T) * num);
+		return;
+	}
+	size_t i;
+	SuperSortVector<MergeNode> nodes(count * 2 - 1);
+	// ȊO̓m[hcount-2Ȃ̂ŁAc1̏o̓obt@ɂ
+	T* fifo = (T*)AlignedMalloc(sizeof(T) * SUPERSORT_MERGE_FIFO * 32 * (count - 1));
+	T* root = fifo + SUPERSORT_MERGE_FIFO * 32 * (count - 2);
+	BuildMergeTree(nodes.data(), lens, count, fifo, root, SUPERSORT_MERGE_FIFO);
+	for (i = 0; i < count; i++)
+	{
+		nodes[count - 1 + i].buf = runs[i];
+	}
+	while (num)
+	{
+		Refill<false>(&nodes[0]);
+		size_t n = nodes[0].count * 32 < num ? nodes[0].count * 32 : num;
+		memcpy(dst, root, sizeof(T) * n);
+		dst += n;
+		num -= n;
+		if (nodes[0].done)
+		{
+			break;
+		}
+	}
+	AlignedFree(fifo);
+}
+#endif
+
+#ifndef SUPERSORT_SORT_ONLY
+namespace {
+	// ACgĂȂubNPʂœǂݏo
+	// 32vf̒[PADDING_MAXŖ߂ꎞubNǂ
+	struct BlockReader
+	{
+		const T* src;
+		size_t full;
+		size_t blocks;
+		size_t pos;
+		alignas(32) T tail[32];
+
+		void Init(const T* p, size_t num)
+		{
+			size_t i;
+			src = p;
+			full = num / 32;
+			blocks = (num + 31) / 32;
+			pos = 0;
+			for (i = 0; i < num % 32; i++)
+			{
+				tail[i] = p[full * 32 + i];
+			}
+			for (; i < 32; i++)
+			{
+				tail[i] = PADDING_MAX;
+			}
+		}
+		const T* Head() const
+		{
+			return pos < full ? src + pos * 32 : tail;
+		}
+	};
+
+	// ubNo͂Bleftvf𒴂Ȃ悤Ɉꎞ̈oRď
+	struct BlockWriter
+	{
+		T* dst;
+		size_t left;
+
+		void Write(__m256i m0, __m256i m1, __m256i m2, __m256i m3)
+		{
+			if (left >= 32)
+			{
+				_mm256_storeu_si256((__m256i*)(dst + 0), m0);
+				_mm256_storeu_si256((__m256i*)(dst + 8), m1);
+				_mm256_storeu_si256((__m256i*)(dst + 16), m2);
+				_mm256_storeu_si256((__m256i*)(dst + 24), m3);
+				dst += 32;
+				left -= 32;
+			}
+			else if (left)
+			{
+				alignas(32) T tmp[32];
+				_mm256_store_si256((__m256i*)(tmp + 0), m0);
+				_mm256_store_si256((__m256i*)(tmp + 8), m1);
+				_mm256_store_si256((__m256i*)(tmp + 16), m2);
+				_mm256_store_si256((__m256i*)(tmp + 24), m3);
+				memcpy(dst, tmp, sizeof(T) * left);
+				dst += left;
+				left = 0;
+			}
+		}
+	};
+
+	// Cӂ̈ʒun܂Cӂ̒̃\[gς݂̗̃}[W
+	// [𖄂߂PADDING_MAX͏o̖͂ɏW܂̂ŁAnum1 + num2vf߂΂悢
+	void MergeUnaligned(const T* src1, size_t num1, const T* src2, size_t num2, T* dst)
+	{
+		if (num1 == 0 || num2 == 0)
+		{
+			memcpy(dst, num1 ? src1 : src2, sizeof(T) * (num1 + num2));
+			return;
+		}
+		__m256i m0, m1, m2, m3, m4, m5, m6, m7;
+		__m256i maskflip8 = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+		BlockReader in[2];
+		BlockWriter out = { dst, num1 + num2 };
+		in[0].Init(src1, num1);
+		in[1].Init(src2, num2);
+		BlockReader* next = SUPERSORT_GREATER(in[0].Head()[0], in[1].Head()[0]) ? &in[1] : &in[0];
+		const T* p = next->Head();
+		next->pos++;
+		m4 = _mm256_loadu_si256((__m256i*)(p + 0));
+		m5 = _mm256_loadu_si256((__m256i*)(p + 8));
+		m6 = _mm256_loadu_si256((__m256i*)(p + 16));
+		m7 = _mm256_loadu_si256((__m256i*)(p + 24));
+		while (1)
+		{
+			bool rest0 = in[0].pos < in[0].blocks;
+			bool rest1 = in[1].pos < in[1].blocks;
+			if (!rest0 && !rest1)
+			{
+				break;
+			}
+			next = !rest1 || (rest0 && !SUPERSORT_GREATER(in[0].Head()[0], in[1].Head()[0])) ? &in[0] : &in[1];
+			p = next->Head();
+			next->pos++;
+			m0 = _mm256_loadu_si256((__m256i*)(p + 0));
+			m1 = _mm256_loadu_si256((__m256i*)(p + 8));
+			m2 = _mm256_loadu_si256((__m256i*)(p + 16));
+			m3 = _mm256_loadu_si256((__m256i*)(p + 24));
+			Merge3232();
+			out.Write(m0, m1, m2, m3);
+		}
+		out.Write(m4, m5, m6, m7);
+	}
+
+	// src1̐擪ivfsrc2̐擪k-ivf}[Wʂ̐擪kvfɂȂi߂
+	// lsrc1̕Ɏ
+	size_t MergePath(const T* src1, size_t num1, const T* src2, size_t num2, size_t k)
+	{
+		size_t lo = k > num2 ? k - num2 : 0;
+		size_t hi = k < num1 ? k : num1;
+		while (lo < hi)
+		{
+			size_t i = (lo + hi) / 2;
+			if (!SUPERSORT_GREATER(src1[i], src2[k - i - 1]))
+			{
+				lo = i + 1;
+			}
+			else
+			{
+				hi = i;
+			}
+		}
+		return lo;
+	}
+} // namespace
+
+// \[gς݂2̗dstɃ}[W
+// o͂XbhœAeXbh_񕪒Tŋ߂ēƗɃ}[W
+void SuperMerge(const T* src1, size_t num1, const T* src2, size_t num2, T* dst, int threads)
+{
+	size_t total = num1 + num2;
+	if (threads <= 0)
+	{
+		threads = (int)std::thread::hardware_concurrency();
+	}
+	if ((size_t)threads > total / SUPERSORT_PARALLEL_MIN)
+	{
+		threads = (int)(total / SUPERSORT_PARALLEL_MIN);
+	}
+	if (threads <= 1)
+	{
+		MergeUnaligned(src1, num1, src2, num2, dst);
+		return;
+	}
+	auto work = [&](int t) {
+		size_t k0 = total * t / threads;
+		size_t k1 = total * (t + 1) / threads;
+		size_t i0 = MergePath(src1, num1, src2, num2, k0);
+		size_t i1 = MergePath(src1, num1, src2, num2, k1);
+		MergeUnaligned(src1 + i0, i1 - i0, src2 + (k0 - i0), (k1 - i1) - (k0 - i0), dst + k0);
+	};
+	SuperSortScratchContext scratch;
+	SuperSortVector<std::thread> pool;
+	int t;
+	for (t = 1; t < threads; t++)
+	{
+		pool.emplace_back([&scratch, &work](int i) { SuperSortScratchScope scope(scratch); work(i); }, t);
+	}
+	work(0);
+	for (auto& th : pool)
+	{
+		th.join();
+	}
+}
+#endif
+
+#ifndef SUPERSORT_SORT_ONLY
+// threshold傫vfdstɋl߂ĕԂ
+// dstɂnum+7vf̗̈悪Kv
+size_t SuperTopKFilter(T* dst, const T* src, size_t num, T threshold)
+{
+	__m256i th = _mm256_set1_epi32(threshold);
+	size_t i, n = 0;
+	for (i = 0; i + 8 <= num; i += 8)
+	{
+		__m256i m = _mm256_loadu_si256((__m256i*)(src + i));
+		// thresholdȉ̃[max(m, th) == thƂȂ
+		__m256i le = _mm256_cmpeq_epi32(_mm256_max_epi32(m, th), th);
+		unsigned int mask = ~_mm256_movemask_ps(_mm256_castsi256_ps(le)) & 0xFF;
+		if (mask)
+		{
+			n += LeftPack(dst + n, m, mask);
+		}
+	}
+	for (; i < num; i++)
+	{
+		if (src[i] > threshold)
+		{
+			dst[n++] = src[i];
+		}
+	}
+	return n;
+}
+
+// \[gς݂̏topsizevfƖ\[gbuf}[WA傫topsizevftopɎc
+// topsize, bufsize64ȏ32̔{Aworkɂtopsize+bufsizevf̗̈悪Kv
+void SuperTopKMerge(T* top, size_t topsize, T* buf, size_t bufsize, T* work)
+{
+	SuperSortRec(work, buf, buf, bufsize / 32);
+	Merge(top, topsize / 32, buf, bufsize / 32, work);
+	memcpy(top, work + bufsize, sizeof(T) * topsize);
+}
+
+// \[gďdAcvfԂ
+// d͍ŏIĩ}[WoubNƂɎ菜̂ŁA\[gɔzǂݒȂ
+size_t SuperSortUnique(T* array, size_t num, size_t* counts)
+{
+	if (num == 0)
+	{
+		return 0;
+	}
+	UniqueSink sink;
+	sink.dst = array;
+	sink.counts = counts;
+	sink.num = num;
+	sink.pos = sink.n = sink.start = 0;
+	sink.last = _mm256_setzero_si256();
+	size_t alignedsize = num < 64 ? 64 : ((num - 1) | 31) + 1;
+	T* buf = array;
+	if (num != alignedsize || (((size_t)array) & 31))
+	{
+		buf = (T*)AlignedMalloc(sizeof(T) * alignedsize);
+		size_t i;
+		for (i = num; i < alignedsize; i++)
+		{
+			buf[i] = PADDING_MAX;
+		}
+		memcpy(buf, array, sizeof(T) * num);
+	}
+	if (alignedsize > 128)
+	{
+		SuperSortAligned(buf, alignedsize / 32, false, &sink);
+	}
+	else
+	{
+		if (alignedsize == 64)
+		{
+			SuperSort64(buf);
+		}
+		else if (alignedsize == 96)
+		{
+			SuperSort96(buf);
+		}
+		else
+		{
+			SuperSort128(buf);
+		}
+		// }[W̖傫ł́A\[gς݂̃ubN̂܂ܓn
+		size_t i;
+		for (i = 0; i < alignedsize; i += 32)
+		{
+			StoreBlock<false, true>(NULL, _mm256_load_si256((__m256i*)(buf + i + 0)), _mm256_load_si256((__m256i*)(buf + i + 8)), _mm256_load_si256((__m256i*)(buf + i + 16)), _mm256_load_si256((__m256i*)(buf + i + 24)), &sink);
+		}
+	}
+	if (buf != array)
+	{
+		AlignedFree(buf);
+	}
+	if (counts)
+	{
+		counts[sink.n - 1] = num - sink.start;
+	}
+	return sink.n;
+}
+#endif
+
+#ifdef SUPERSORT_KEY_ABS
+// Βl̏Ƀ\[gBΒlꍇ͕̒lɂȂ
+void SuperSortAbs(int* array, size_t num)
+{
+	SuperSort((T*)array, num);
+}
+#endif
+
+#ifdef SUPERSORT_KEY_FLOAT
+// rbg𔽓]rbg̏Ƀ\[gB-NaN < -inf < ... < -0.0 < +0.0 < ... < +inf < +NaN
+void SuperSortF(float* array, size_t num)
+{
+	SuperSort((T*)array, num);
+}
+#endif
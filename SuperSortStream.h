@@ -0,0 +1,185 @@
+﻿/*
+	Copyright 2018 Toshihiro Shirakawa
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#pragma once
+// 少しずつ届くデータを受け取りながらソートする
+// 一杯になったチャンクは裏のスレッドでソートしておき、Finishでは最後のチャンクのソートと全体のマージだけを行う
+
+#include <stddef.h>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include "SuperSort.h"
+#include "SuperSortVector.h"
+
+template<typename T>
+class SuperSortStream
+{
+public:
+	// chunkは1チャンクの要素数。作業領域と合わせてL2に収まる程度にすると各チャンクのソートが速い
+	SuperSortStream(size_t chunk = 1 << 16)
+	{
+		// チャンクはSuperSortの整列済みの経路に乗るよう32要素単位、64要素以上にする
+		m_chunkSize = chunk < 64 ? 64 : ((chunk - 1) | 31) + 1;
+		m_current = NULL;
+		m_fill = 0;
+		m_total = 0;
+		m_pending = 0;
+		m_stop = false;
+		m_worker = std::thread([this]() { Run(); });
+	}
+	~SuperSortStream()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_cond.notify_all();
+		m_worker.join();
+		Clear();
+	}
+	SuperSortStream(const SuperSortStream&) = delete;
+	SuperSortStream& operator=(const SuperSortStream&) = delete;
+
+	void Push(const T* values, size_t num)
+	{
+		m_total += num;
+		while (num)
+		{
+			if (!m_current)
+			{
+				m_current = (T*)AlignedMalloc(sizeof(T) * m_chunkSize);
+				m_fill = 0;
+			}
+			size_t n = m_chunkSize - m_fill < num ? m_chunkSize - m_fill : num;
+			memcpy(m_current + m_fill, values, sizeof(T) * n);
+			m_fill += n;
+			values += n;
+			num -= n;
+			if (m_fill == m_chunkSize)
+			{
+				Submit();
+			}
+		}
+	}
+	void Push(T value)
+	{
+		Push(&value, 1);
+	}
+	// これまでに受け取った要素数
+	size_t Size() const
+	{
+		return m_total;
+	}
+	// 受け取った全ての要素をソートしてoutに書き込み、空の状態に戻る
+	// outにはSize()要素分の領域が必要
+	void Finish(T* out)
+	{
+		if (m_current)
+		{
+			// 最後のチャンクは端数をパディングで埋めてこのスレッドでソートする
+			size_t padded = m_fill < 64 ? 64 : ((m_fill - 1) | 31) + 1;
+			for (size_t i = m_fill; i < padded; i++)
+			{
+				m_current[i] = (std::numeric_limits<T>::max)();
+			}
+			SuperSort(m_current, padded);
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_chunks.push_back(m_current);
+			m_lens.push_back(padded / 32);
+			m_current = NULL;
+		}
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_done.wait(lock, [this]() { return m_pending == 0; });
+		}
+		SuperMergeRuns(m_chunks.data(), m_lens.data(), m_chunks.size(), out, m_total);
+		Clear();
+	}
+
+private:
+	// 一杯になったチャンクを裏のスレッドに渡す
+	void Submit()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_chunks.push_back(m_current);
+			m_lens.push_back(m_chunkSize / 32);
+			m_queue.push_back(m_current);
+			m_pending++;
+		}
+		m_current = NULL;
+		m_cond.notify_one();
+	}
+	// 裏のスレッドは作ったスレッドのアリーナと統計を使う
+	void Run()
+	{
+		SuperSortScratchScope scope(m_scratch);
+		while (1)
+		{
+			T* chunk;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_cond.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+				if (m_queue.empty())
+				{
+					return;
+				}
+				chunk = m_queue.front();
+				m_queue.pop_front();
+			}
+			SuperSort(chunk, m_chunkSize);
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_pending--;
+			}
+			m_done.notify_all();
+		}
+	}
+	void Clear()
+	{
+		for (T* chunk : m_chunks)
+		{
+			AlignedFree(chunk);
+		}
+		m_chunks.clear();
+		m_lens.clear();
+		if (m_current)
+		{
+			AlignedFree(m_current);
+			m_current = NULL;
+		}
+		m_fill = 0;
+		m_total = 0;
+	}
+
+	size_t m_chunkSize;
+	T* m_current;
+	size_t m_fill;
+	size_t m_total;
+	size_t m_pending;
+	bool m_stop;
+	SuperSortVector<T*> m_chunks;
+	SuperSortVector<size_t> m_lens;
+	std::deque<T*> m_queue;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::condition_variable m_done;
+	SuperSortScratchContext m_scratch;
+	std::thread m_worker;
+};
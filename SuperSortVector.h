@@ -0,0 +1,97 @@
+﻿/*
+	Copyright 2018 Toshihiro Shirakawa
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#pragma once
+// ソート内部で作業領域に使うstd::vectorと、コンテナが長く保持するデータのアロケータ
+
+#include <stdlib.h>
+#include <immintrin.h>
+#include <vector>
+
+#include "SuperSort.h"
+
+// AlignedMallocを使うアロケータ。ソート内部のstd::vectorもアリーナと統計の対象にする
+template<typename T>
+struct SuperSortAllocator
+{
+	typedef T value_type;
+	SuperSortAllocator() = default;
+	template<typename U>
+	SuperSortAllocator(const SuperSortAllocator<U>&)
+	{
+	}
+	T* allocate(size_t n)
+	{
+		T* p = (T*)AlignedMalloc(sizeof(T) * n);
+		if (!p)
+		{
+			abort();
+		}
+		return p;
+	}
+	void deallocate(T* p, size_t)
+	{
+		AlignedFree(p);
+	}
+	template<typename U>
+	bool operator==(const SuperSortAllocator<U>&) const
+	{
+		return true;
+	}
+	template<typename U>
+	bool operator!=(const SuperSortAllocator<U>&) const
+	{
+		return false;
+	}
+};
+
+template<typename T>
+using SuperSortVector = std::vector<T, SuperSortAllocator<T>>;
+
+// 64バイト(キャッシュライン)境界に揃えてヒープから確保するアロケータ
+// 作業領域のアリーナはソートの呼び出しの間だけ使う前提なので、コンテナが保持し続けるデータはこちらで確保する
+template<typename T>
+struct SuperSortHeapAllocator
+{
+	typedef T value_type;
+	SuperSortHeapAllocator() = default;
+	template<typename U>
+	SuperSortHeapAllocator(const SuperSortHeapAllocator<U>&)
+	{
+	}
+	T* allocate(size_t n)
+	{
+		T* p = (T*)_mm_malloc(sizeof(T) * n, 64);
+		if (!p)
+		{
+			abort();
+		}
+		return p;
+	}
+	void deallocate(T* p, size_t)
+	{
+		_mm_free(p);
+	}
+	template<typename U>
+	bool operator==(const SuperSortHeapAllocator<U>&) const
+	{
+		return true;
+	}
+	template<typename U>
+	bool operator!=(const SuperSortHeapAllocator<U>&) const
+	{
+		return false;
+	}
+};
@@ -0,0 +1,248 @@
+﻿/*
+	Copyright 2018 Toshihiro Shirakawa
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#pragma once
+// 少しずつ挿入される要素をソート済みに保つコンテナ
+// 挿入はバッファに貯め、一杯になったらソートして段(ソート済みの列)に加える
+// 段iの長さはバッファの2^i倍で、同じ長さの段ができたらマージして次の段に上げる
+// 検索はバッファをベクタ比較で走査し、各段はSuperLowerBoundで探索する
+// バッファと段はAllocで確保する。Allocは32バイト境界に揃った領域を返す必要がある
+
+#include <stddef.h>
+#include <immintrin.h>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "SuperSort.h"
+#include "SuperSortVector.h"
+#include "SuperSearch.h"
+
+// 挿入バッファの要素数。SuperSort128でソートされる大きさにする
+#ifndef SUPERSORTEDARRAY_BUFFER
+#define SUPERSORTEDARRAY_BUFFER 128
+#endif
+
+template<typename T, typename Alloc = SuperSortHeapAllocator<T>>
+class SuperSortedArray
+{
+	static_assert(sizeof(T) == 4, "SuperSortedArrayは32ビットの要素だけに対応する");
+
+public:
+	explicit SuperSortedArray(const Alloc& alloc = Alloc())
+		: m_alloc(alloc), m_buf(SUPERSORTEDARRAY_BUFFER, alloc)
+	{
+		m_fill = 0;
+		m_size = 0;
+	}
+	SuperSortedArray(const SuperSortedArray&) = delete;
+	SuperSortedArray& operator=(const SuperSortedArray&) = delete;
+
+	void Insert(T value)
+	{
+		m_buf[m_fill++] = value;
+		m_size++;
+		if (m_fill == SUPERSORTEDARRAY_BUFFER)
+		{
+			Flush();
+		}
+	}
+	void Insert(const T* values, size_t num)
+	{
+		while (num)
+		{
+			size_t n = SUPERSORTEDARRAY_BUFFER - m_fill < num ? SUPERSORTEDARRAY_BUFFER - m_fill : num;
+			memcpy(m_buf.data() + m_fill, values, sizeof(T) * n);
+			m_fill += n;
+			m_size += n;
+			values += n;
+			num -= n;
+			if (m_fill == SUPERSORTEDARRAY_BUFFER)
+			{
+				Flush();
+			}
+		}
+	}
+	size_t Size() const
+	{
+		return m_size;
+	}
+	bool Contains(T value) const
+	{
+		if (ScanBuffer(value).equal)
+		{
+			return true;
+		}
+		for (const auto& level : m_levels)
+		{
+			size_t pos;
+			SuperLowerBound(level.data(), level.size(), &value, 1, &pos);
+			if (pos < level.size() && level[pos] == value)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+	// value未満の要素数
+	size_t Rank(T value) const
+	{
+		size_t rank;
+		Rank(&value, 1, &rank);
+		return rank;
+	}
+	// count個のvalueそれぞれについて、value未満の要素数をresultに返す
+	// 各段はまとめてSuperLowerBoundに渡すので、クエリが多いほどギャザーによる探索が効く
+	void Rank(const T* values, size_t count, size_t* result) const
+	{
+		size_t q;
+		for (q = 0; q < count; q++)
+		{
+			result[q] = ScanBuffer(values[q]).less;
+		}
+		SuperSortVector<size_t> pos(count);
+		for (const auto& level : m_levels)
+		{
+			if (level.empty())
+			{
+				continue;
+			}
+			SuperLowerBound(level.data(), level.size(), values, count, pos.data());
+			for (q = 0; q < count; q++)
+			{
+				result[q] += pos[q];
+			}
+		}
+	}
+	// value以上の最小の要素をresultに返す。無ければfalseを返す
+	bool LowerBound(T value, T& result) const
+	{
+		BufferScan scan = ScanBuffer(value);
+		bool found = scan.found;
+		result = scan.lower;
+		for (const auto& level : m_levels)
+		{
+			size_t pos;
+			SuperLowerBound(level.data(), level.size(), &value, 1, &pos);
+			if (pos < level.size() && (!found || level[pos] < result))
+			{
+				result = level[pos];
+				found = true;
+			}
+		}
+		return found;
+	}
+	// 全ての要素を昇順にoutへ書き出す。outにはSize()要素分の領域が必要
+	void CopyTo(T* out) const
+	{
+		SuperSortVector<T*> runs;
+		SuperSortVector<size_t> lens;
+		for (const auto& level : m_levels)
+		{
+			if (level.size())
+			{
+				runs.push_back((T*)level.data());
+				lens.push_back(level.size() / 32);
+			}
+		}
+		// バッファの端数はパディングで埋めたコピーをソートして1本の列として加える
+		T* tail = NULL;
+		if (m_fill)
+		{
+			size_t padded = m_fill < 64 ? 64 : ((m_fill - 1) | 31) + 1;
+			tail = (T*)AlignedMalloc(sizeof(T) * padded);
+			memcpy(tail, m_buf.data(), sizeof(T) * m_fill);
+			std::fill(tail + m_fill, tail + padded, (std::numeric_limits<T>::max)());
+			SuperSort(tail, padded);
+			runs.push_back(tail);
+			lens.push_back(padded / 32);
+		}
+		SuperMergeRuns(runs.data(), lens.data(), runs.size(), out, m_size);
+		AlignedFree(tail);
+	}
+
+private:
+	struct BufferScan
+	{
+		size_t less;
+		bool equal;
+		bool found;
+		T lower;
+	};
+
+	// バッファを8要素ずつベクタ比較で走査する。value未満の要素数、valueと等しい要素の有無、
+	// value以上の最小の要素を一度に求める。m_fillより後ろのレーンはマスクで除く
+	BufferScan ScanBuffer(T value) const
+	{
+		// 比較は符号付きで行うので、符号なしの場合は符号ビットを反転して順序を合わせる
+		const int flip = std::numeric_limits<T>::is_signed ? 0 : (int)0x80000000U;
+		__m256i f = _mm256_set1_epi32(flip);
+		__m256i x = _mm256_set1_epi32((int)value ^ flip);
+		__m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		__m256i lower = _mm256_set1_epi32(0x7FFFFFFF);
+		unsigned int equal = 0, upper = 0;
+		size_t less = 0;
+		size_t i;
+		for (i = 0; i < m_fill; i += 8)
+		{
+			__m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)(m_fill - i)), lane);
+			__m256i v = _mm256_xor_si256(_mm256_load_si256((const __m256i*)(m_buf.data() + i)), f);
+			__m256i lt = _mm256_and_si256(_mm256_cmpgt_epi32(x, v), valid);
+			__m256i ge = _mm256_andnot_si256(lt, valid);
+			less += _mm_popcnt_u32(_mm256_movemask_ps(_mm256_castsi256_ps(lt)));
+			equal |= _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(_mm256_cmpeq_epi32(x, v), valid)));
+			upper |= _mm256_movemask_ps(_mm256_castsi256_ps(ge));
+			lower = _mm256_min_epi32(lower, _mm256_blendv_epi8(lower, v, ge));
+		}
+		lower = _mm256_min_epi32(lower, _mm256_permute2x128_si256(lower, lower, 1));
+		lower = _mm256_min_epi32(lower, _mm256_shuffle_epi32(lower, 0x4E));
+		lower = _mm256_min_epi32(lower, _mm256_shuffle_epi32(lower, 0xB1));
+		BufferScan scan;
+		scan.less = less;
+		scan.equal = equal != 0;
+		scan.found = upper != 0;
+		scan.lower = (T)(_mm256_cvtsi256_si32(lower) ^ flip);
+		return scan;
+	}
+
+	// バッファをソートして段0に加え、同じ長さの段が続く限りマージして上の段に上げる
+	void Flush()
+	{
+		SuperSort(m_buf.data(), m_fill);
+		Level carry(m_buf.begin(), m_buf.begin() + m_fill, m_alloc);
+		size_t i;
+		for (i = 0; i < m_levels.size() && m_levels[i].size(); i++)
+		{
+			Level merged(m_levels[i].size() + carry.size(), m_alloc);
+			SuperMerge(m_levels[i].data(), m_levels[i].size(), carry.data(), carry.size(), merged.data(), 1);
+			Level(m_alloc).swap(m_levels[i]);
+			carry.swap(merged);
+		}
+		if (i == m_levels.size())
+		{
+			m_levels.emplace_back(m_alloc);
+		}
+		m_levels[i].swap(carry);
+		m_fill = 0;
+	}
+
+	typedef std::vector<T, Alloc> Level;
+
+	Alloc m_alloc;
+	Level m_buf;
+	size_t m_fill;
+	size_t m_size;
+	std::vector<Level> m_levels;
+};
@@ -0,0 +1,146 @@
+﻿/*
+	Copyright 2018 Toshihiro Shirakawa
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#pragma once
+// 上位k要素の保持。SuperTopKFilterとSuperTopKMergeを使う
+
+#include <string.h>
+#include <limits>
+
+#include "SuperSort.h"
+
+// 入力列のうち大きい方からk要素を保持し続ける
+// 閾値以下の値はバッファに入れずに捨て、バッファが一杯になったらソートして上位k要素とマージする
+template<typename T>
+class SuperTopK
+{
+public:
+	SuperTopK(size_t k, size_t bufsize = 4096)
+	{
+		m_k = k;
+		// Mergeは2ブロック以上の列を必要とするため、64要素以上確保する
+		m_topsize = k < 64 ? 64 : ((k - 1) | 31) + 1;
+		m_bufsize = bufsize < 64 ? 64 : ((bufsize - 1) | 31) + 1;
+		// 左詰めストアは8要素単位で書き込むので余分に確保しておく
+		m_top = (T*)AlignedMalloc(sizeof(T) * m_topsize);
+		m_buf = (T*)AlignedMalloc(sizeof(T) * (m_bufsize + 8));
+		m_work = (T*)AlignedMalloc(sizeof(T) * (m_topsize + m_bufsize));
+		for (size_t i = 0; i < m_topsize; i++)
+		{
+			m_top[i] = (std::numeric_limits<T>::min)();
+		}
+		m_num = 0;
+		m_count = 0;
+		m_threshold = (std::numeric_limits<T>::min)();
+	}
+	~SuperTopK()
+	{
+		AlignedFree(m_top);
+		AlignedFree(m_buf);
+		AlignedFree(m_work);
+	}
+	SuperTopK(const SuperTopK&) = delete;
+	SuperTopK& operator=(const SuperTopK&) = delete;
+
+	void Push(T value)
+	{
+		if (m_k && (m_count < m_k || value > m_threshold))
+		{
+			m_buf[m_num++] = value;
+			if (m_num == m_bufsize)
+			{
+				Flush();
+			}
+		}
+	}
+	void Push(const T* values, size_t num)
+	{
+		if (!m_k)
+		{
+			return;
+		}
+		while (num)
+		{
+			size_t n = m_bufsize - m_num;
+			if (n > num)
+			{
+				n = num;
+			}
+			if (m_count < m_k)
+			{
+				// k要素揃うまでは全て受け入れる
+				memcpy(m_buf + m_num, values, sizeof(T) * n);
+				m_num += n;
+			}
+			else
+			{
+				m_num += SuperTopKFilter(m_buf + m_num, values, n, m_threshold);
+			}
+			values += n;
+			num -= n;
+			if (m_num == m_bufsize || (m_count < m_k && m_count + m_num >= m_k))
+			{
+				Flush();
+			}
+		}
+	}
+	// 保持している要素を昇順でoutに書き出し、その数を返す
+	size_t Get(T* out)
+	{
+		Flush();
+		memcpy(out, m_top + m_topsize - m_count, sizeof(T) * m_count);
+		return m_count;
+	}
+	// k番目に大きい値。k要素揃うまではTの最小値
+	T Threshold() const
+	{
+		return m_threshold;
+	}
+	size_t Size() const
+	{
+		return m_count + m_num < m_k ? m_count + m_num : m_k;
+	}
+
+private:
+	void Flush()
+	{
+		if (!m_num)
+		{
+			return;
+		}
+		size_t alignedsize = m_num < 64 ? 64 : ((m_num - 1) | 31) + 1;
+		for (size_t i = m_num; i < alignedsize; i++)
+		{
+			m_buf[i] = (std::numeric_limits<T>::min)();
+		}
+		SuperTopKMerge(m_top, m_topsize, m_buf, alignedsize, m_work);
+		m_count = m_count + m_num < m_k ? m_count + m_num : m_k;
+		m_num = 0;
+		if (m_count == m_k)
+		{
+			m_threshold = m_top[m_topsize - m_k];
+		}
+	}
+
+	size_t m_k;
+	size_t m_topsize;
+	size_t m_bufsize;
+	size_t m_num;
+	size_t m_count;
+	T m_threshold;
+	T* m_top;
+	T* m_buf;
+	T* m_work;
+};
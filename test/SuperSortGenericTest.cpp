@@ -0,0 +1,134 @@
+﻿/*
+	Copyright 2018 Toshihiro Shirakawa
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+// supersort::sortがstd::sortの置き換えとして値を失わないことを確かめる
+// ライブラリの全ての.cppと一緒にビルドして実行し、失敗すると0以外を返す
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "../SuperSortGeneric.h"
+
+namespace {
+	unsigned long long Bits(double d)
+	{
+		unsigned long long b;
+		memcpy(&b, &d, sizeof(b));
+		return b;
+	}
+
+	// 出力のビット列が入力の並べ替えになっていて、NaN以外の値が昇順に並び、NaNが末尾に集まっているか
+	bool CheckDouble(const std::vector<double>& input, const std::vector<double>& output)
+	{
+		std::vector<unsigned long long> a, b;
+		for (double d : input)
+		{
+			a.push_back(Bits(d));
+		}
+		for (double d : output)
+		{
+			b.push_back(Bits(d));
+		}
+		std::sort(a.begin(), a.end());
+		std::sort(b.begin(), b.end());
+		if (a != b)
+		{
+			return false;
+		}
+		double last = -std::numeric_limits<double>::infinity();
+		bool nan = false;
+		for (double d : output)
+		{
+			if (d != d)
+			{
+				nan = true;
+				continue;
+			}
+			if (nan || d < last)
+			{
+				return false;
+			}
+			last = d;
+		}
+		return true;
+	}
+
+	// ±0、NaN、無限大を多く含むdoubleの列
+	bool TestDoubleSpecials()
+	{
+		const double specials[] = {
+			0.0, -0.0,
+			std::numeric_limits<double>::quiet_NaN(), -std::numeric_limits<double>::quiet_NaN(),
+			std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+			std::numeric_limits<double>::denorm_min(), -1.0,
+		};
+		std::mt19937 rng(1);
+		size_t num;
+		for (num = 0; num < 3000; num += num < 100 ? 1 : 97)
+		{
+			std::vector<double> input(num);
+			size_t i;
+			for (i = 0; i < num; i++)
+			{
+				input[i] = rng() % 2 ? specials[rng() % 8] : (double)(int)rng() / 1000;
+			}
+			std::vector<double> output = input;
+			supersort::sort(output);
+			if (!CheckDouble(input, output))
+			{
+				printf("double specials: num=%zu failed\n", num);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool TestInt()
+	{
+		std::mt19937 rng(2);
+		size_t num;
+		for (num = 0; num < 3000; num += num < 100 ? 1 : 97)
+		{
+			std::vector<int> input(num);
+			size_t i;
+			for (i = 0; i < num; i++)
+			{
+				input[i] = (int)rng();
+			}
+			std::vector<int> output = input;
+			std::sort(input.begin(), input.end());
+			supersort::sort(output.begin(), output.end());
+			if (input != output)
+			{
+				printf("int: num=%zu failed\n", num);
+				return false;
+			}
+		}
+		return true;
+	}
+} // namespace
+
+int main()
+{
+	bool ok = TestDoubleSpecials();
+	ok = TestInt() && ok;
+	printf("%s\n", ok ? "ok" : "failed");
+	return ok ? 0 : 1;
+}